@@ -1,5 +1,9 @@
 #pragma once
+#include <algorithm>
+#include <cassert>
+#include <vector>
 #include "solver.hpp"
+#include "dual.hpp"
 #include "black_scholes.hpp"
 
 namespace sfinx { namespace baw {
@@ -18,33 +22,33 @@ inline Num q1(Num N, Num M, Num K)
   return (-(N - 1) - sqrt((N - 1) * (N - 1) + 4 * M / K)) / 2;
 }
 
-template <typename Num>
+template <typename Policy = normal::exact, typename Num>
 inline Num rhs(Num d1, Num Si, Num X, Num T, Num r, Num b, Num v, Num q2)
 {
   auto d = std::make_pair(d1, d1 - v * sqrt(T));
-  auto C = bsm_general::aux::call(d, Si, X, T, r, b);
-  return C + (1 - exp((b - r) * T) * normal_cdf(d1)) * Si / q2;
+  auto C = bsm_general::aux::call<Policy>(d, Si, X, T, r, b);
+  return C + (1 - exp((b - r) * T) * Policy::cdf(d1)) * Si / q2;
 }
 
-template <typename Num>
+template <typename Policy = normal::exact, typename Num>
 inline Num hs(Num d1, Num Sj, Num X, Num T, Num r, Num b, Num v, Num q1)
 {
   auto d = std::make_pair(d1, d1 - v * sqrt(T));
-  auto P = bsm_general::aux::put(d, Sj, X, T, r, b);
-  return P - (1 - exp((b - r) * T) * normal_cdf(-d1)) * Sj / q1;
+  auto P = bsm_general::aux::put<Policy>(d, Sj, X, T, r, b);
+  return P - (1 - exp((b - r) * T) * Policy::cdf(-d1)) * Sj / q1;
 }
 
-template <typename Num>
+template <typename Policy = normal::exact, typename Num>
 inline Num bi(Num d1, Num T, Num r, Num b, Num v, Num q2)
 {
-  auto N = normal_cdf(d1), n = normal_pdf(d1);
+  auto N = Policy::cdf(d1), n = Policy::pdf(d1);
   return exp((b - r) * T) * N * (1 - 1 / q2) + (1 - exp((b - r) * T) * n / (v * sqrt(T))) / q2;
 }
 
-template <typename Num>
+template <typename Policy = normal::exact, typename Num>
 inline Num bj(Num d1, Num T, Num r, Num b, Num v, Num q1)
 {
-  auto N = normal_cdf(-d1), n = normal_pdf(-d1);
+  auto N = Policy::cdf(-d1), n = Policy::pdf(-d1);
   return -exp((b - r) * T) * N * (1 - 1 / q1) - (1 + exp((b - r) * T) * n / (v * sqrt(T))) / q1;
 }
 
@@ -66,8 +70,18 @@ Num seed_Sss(Num N, Num M, Num X, Num T, Num b, Num v)
   return su + (X - su) * exp(h1); 
 }
 
+/**
+ * Early exercise boundary: critical price S, exponent q and coefficient A of the early exercise
+ * premium A * (S / S*)^q. For fixed (T, r, b, v) both S* and A are linear in the strike X.
+ **/
 template <typename Num>
-Num solve_Ss(Num X, Num T, Num r, Num b, Num v)
+struct boundary
+{
+  Num S, q, A;
+};
+
+template <typename Policy = normal::exact, typename Num>
+boundary<Num> call_boundary(Num X, Num T, Num r, Num b, Num v)
 {
   Num N = 2 * b / (v * v);
   Num M = 2 * r / (v * v);
@@ -77,21 +91,22 @@ Num solve_Ss(Num X, Num T, Num r, Num b, Num v)
   Num d1 = bsm_general::d1(Si, X, T, b, v);
   Num q2_ = q2(N, M, K);
   Num LHS = Si - X;
-  Num RHS = rhs(d1, Si, X, T, r, b, v, q2_);
-  Num bi_ = bi(d1, T, r, b, v, q2_);
+  Num RHS = rhs<Policy>(d1, Si, X, T, r, b, v, q2_);
+  Num bi_ = bi<Policy>(d1, T, r, b, v, q2_);
   Num eps = 1e-6;
   while (std::abs(LHS - RHS) / X > eps){
     Si = (X + RHS - bi_ * Si) / (1 - bi_);
     d1 = bsm_general::d1(Si, X, T, b, v);
     LHS = Si - X;
-    RHS = rhs(d1, Si, X, T, r, b, v, q2_);
-    bi_ = bi(d1, T, r, b, v, q2_);
+    RHS = rhs<Policy>(d1, Si, X, T, r, b, v, q2_);
+    bi_ = bi<Policy>(d1, T, r, b, v, q2_);
   }
-  return Si;
+  boundary<Num> B = { Si, q2_, (Si / q2_) * (1 - exp((b - r) * T) * Policy::cdf(d1)) };
+  return B;
 }
 
-template <typename Num>
-Num solve_Sss(Num X, Num T, Num r, Num b, Num v)
+template <typename Policy = normal::exact, typename Num>
+boundary<Num> put_boundary(Num X, Num T, Num r, Num b, Num v)
 {
   Num N = 2 * b / (v * v);
   Num M = 2 * r / (v * v);
@@ -101,54 +116,248 @@ Num solve_Sss(Num X, Num T, Num r, Num b, Num v)
   Num d1 = bsm_general::d1(Sj, X, T, b, v);
   Num q1_ = q1(N, M, K);
   Num VS = X - Sj;
-  Num HS = hs(d1, Sj, X, T, r, b, v, q1_);
-  Num bj_ = bj(d1, T, r, b, v, q1_);
+  Num HS = hs<Policy>(d1, Sj, X, T, r, b, v, q1_);
+  Num bj_ = bj<Policy>(d1, T, r, b, v, q1_);
   Num eps = 1e-6;
   while (std::abs(VS - HS) / X > eps) {
     Sj = (X - HS + bj_ * Sj) / (1 + bj_);
     d1 = bsm_general::d1(Sj, X, T, b, v);
     VS = X - Sj;
-    HS = hs(d1, Sj, X, T, r, b, v, q1_);
-    bj_ = bj(d1, T, r, b, v, q1_);
+    HS = hs<Policy>(d1, Sj, X, T, r, b, v, q1_);
+    bj_ = bj<Policy>(d1, T, r, b, v, q1_);
   }
-  return Sj;
+  boundary<Num> B = { Sj, q1_, -(Sj / q1_) * (1 - exp((b - r) * T) * Policy::cdf(-d1)) };
+  return B;
+}
+
+template <typename Policy = normal::exact, typename Num>
+Num solve_Ss(Num X, Num T, Num r, Num b, Num v)
+{
+  return call_boundary<Policy>(X, T, r, b, v).S;
+}
+
+template <typename Policy = normal::exact, typename Num>
+Num solve_Sss(Num X, Num T, Num r, Num b, Num v)
+{
+  return put_boundary<Policy>(X, T, r, b, v).S;
+}
+
+/// Values at strikes X from the boundary u of the unit strike, Num is double or simd::pack
+template <typename Policy, typename Num>
+Num call(boundary<double> const& u, Num S, Num X, Num T, Num r, Num b, Num v)
+{
+  Num Ss = X * u.S;
+  Num premium = X * u.A * exp(u.q * log(S / Ss));
+  return simd::select(S < Ss, bsm_general::call<Policy>(S, X, T, r, b, v) + premium, S - X);
+}
+
+template <typename Policy, typename Num>
+Num put(boundary<double> const& u, Num S, Num X, Num T, Num r, Num b, Num v)
+{
+  Num Sss = X * u.S;
+  Num premium = X * u.A * exp(u.q * log(S / Sss));
+  return simd::select(S > Sss, bsm_general::put<Policy>(S, X, T, r, b, v) + premium, X - S);
 }
 
 } // namespace sfinx::baw::aux
 
-template <typename Num>
+template <typename Policy = normal::exact, typename Num>
 Num call(Num S, Num X, Num T, Num r, Num b, Num v)
 {
   if (b >= r)
-    return bsm_general::call(S, X, T, r, b, v);
-  Num Ss = aux::solve_Ss(X, T, r, b, v);
-  Num N = 2 * b / (v * v);
-  Num M = 2 * r / (v * v);
-  Num K = 1 - exp(-r * T);
-  Num q2 = aux::q2(N, M, K);
-  Num d1 = bsm_general::d1(Ss, X, T, b, v);
-  Num A2 = (Ss / q2) * (1 - exp((b - r) * T) * normal_cdf(d1));
-  if (S < Ss)
-    return bsm_general::call(S, X, T, r, b, v) + A2 * pow(S / Ss, q2);
+    return bsm_general::call<Policy>(S, X, T, r, b, v);
+  auto B = aux::call_boundary<Policy>(X, T, r, b, v);
+  if (S < B.S)
+    return bsm_general::call<Policy>(S, X, T, r, b, v) + B.A * pow(S / B.S, B.q);
   else
     return S - X;
 }
 
-template <typename Num>
+template <typename Policy = normal::exact, typename Num>
 Num put(Num S, Num X, Num T, Num r, Num b, Num v)
 {
-  Num Sss = aux::solve_Sss(X, T, r, b, v);
-  Num N = 2 * b / (v * v);
-  Num M = 2 * r / (v * v);
-  Num K = 1 - exp(-r * T);
-  Num q1 = aux::q1(N, M, K);
-  Num d1 = bsm_general::d1(Sss, X, T, b, v);
-  Num A1 = -(Sss / q1) * (1 - exp((b - r) * T) * normal_cdf(-d1));
-  if (S > Sss)
-    return bsm_general::put(S, X, T, r, b, v) + A1 * pow(S / Sss, q1);
+  auto B = aux::put_boundary<Policy>(X, T, r, b, v);
+  if (S > B.S)
+    return bsm_general::put<Policy>(S, X, T, r, b, v) + B.A * pow(S / B.S, B.q);
   else
     return X - S;
 }
 
+namespace aux {
+
+/**
+ * Greeks of the american option, phi is 1 for a call and -1 for a put. The boundary is solved
+ * in double, then one Newton step on the boundary equation is taken with (v, T, r, b) as dual
+ * numbers: from the root that step carries the implicit derivative of S*, through which the
+ * premium is differentiated. delta and gamma of the premium are analytic in S.
+ **/
+template <typename Policy>
+option::greeks<double> greeks(double phi, double S, double X, double T, double r, double b,
+                              double v)
+{
+  typedef ad::dual<4> D;
+  boundary<double> B = phi > 0 ? call_boundary<Policy>(X, T, r, b, v)
+                               : put_boundary<Policy>(X, T, r, b, v);
+  if (phi * (S - B.S) >= 0)
+    return option::aux::exercised(phi, S, X);
+
+  D S_(S), X_(X), v_(v, 0), T_(T, 1), r_(r, 2), b_(b, 3);
+  D N = 2 * b_ / (v_ * v_), M = 2 * r_ / (v_ * v_), K = 1 - exp(-r_ * T_);
+  D q = phi > 0 ? q2(N, M, K) : q1(N, M, K);
+  D Ss(B.S), d1 = bsm_general::d1(Ss, X_, T_, b_, v_);
+  double d1_ = d1.v, slope = phi > 0 ? 1 - bi<Policy>(d1_, T, r, b, v, B.q)
+                                     : -1 - bj<Policy>(d1_, T, r, b, v, B.q);
+  D G = phi > 0 ? Ss - X_ - rhs<Policy>(d1, Ss, X_, T_, r_, b_, v_, q)
+                : X_ - Ss - hs<Policy>(d1, Ss, X_, T_, r_, b_, v_, q);
+  Ss = Ss - G / slope;
+  Ss.v = B.S;
+  d1 = bsm_general::d1(Ss, X_, T_, b_, v_);
+  D A = phi * (Ss / q) * (1 - exp((b_ - r_) * T_) * Policy::cdf(phi * d1));
+  D P = A * pow(S_ / Ss, q);
+
+  bsm_general::aux::shared<D, Policy> e(S_, X_, T_, r_, b_, v_);
+  auto E = bsm_general::aux::greeks(e, D(phi), S_, X_, T_, r_, b_, v_);
+  return option::aux::from_dual(E.value + P, E.delta + q * P / S_,
+                                E.gamma + q * (q - 1) * P / (S_ * S_));
+}
+
+} // namespace sfinx::baw::aux
+
+/**
+ * Value with delta, gamma, vega, vanna, theta, charm, rho and carry in one pass, volga is NaN
+ **/
+template <option::Type type, typename Policy = normal::exact>
+option::greeks<double> greeks(double S, double X, double T, double r, double b, double v)
+{
+  static_assert(type != option::Type::Both, "greeks of a call or of a put");
+  if (type == option::Type::Call && b >= r)
+    return bsm_general::greeks<option::Type::Call, Policy>(S, X, T, r, b, v);
+  return aux::greeks<Policy>(type == option::Type::Call ? 1.0 : -1.0, S, X, T, r, b, v);
+}
+
+/**
+ * Batch greeks, each field of out is a column of results
+ **/
+template <option::Type type, typename Policy = normal::exact>
+void greeks(span<double const> S, span<double const> X, span<double const> T,
+            span<double const> r, span<double const> b, span<double const> v,
+            option::greeks<span<double>> const& out)
+{
+  size_t n = S.size();
+  assert(X.size() == n && T.size() == n && r.size() == n && b.size() == n && v.size() == n);
+  for (size_t i = 0; i < n; ++i)
+    bsm_general::aux::store(out, i, greeks<type, Policy>(S[i], X[i], T[i], r[i], b[i], v[i]));
+}
+
+/**
+ * Recently solved unit-strike boundaries keyed on (type, T, r, b, v), the oldest entry is
+ * replaced once capacity is reached. hits() and misses() count the lookups, to size it.
+ * Not synchronized, use one cache per thread.
+ **/
+template <typename Policy = normal::exact>
+class cache
+{
+public:
+  explicit cache(size_t capacity = 64)
+    : entries_(capacity), size_(0), next_(0), hits_(0), misses_(0)
+  {
+    assert(capacity > 0);
+  }
+
+  aux::boundary<double> const& call(double T, double r, double b, double v)
+  {
+    return find(option::Type::Call, T, r, b, v);
+  }
+
+  aux::boundary<double> const& put(double T, double r, double b, double v)
+  {
+    return find(option::Type::Put, T, r, b, v);
+  }
+
+  size_t hits() const { return hits_; }
+  size_t misses() const { return misses_; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return entries_.size(); }
+
+  void clear()
+  {
+    size_ = next_ = hits_ = misses_ = 0;
+  }
+
+private:
+  struct entry
+  {
+    option::Type type;
+    double T, r, b, v;
+    aux::boundary<double> unit;
+  };
+
+  aux::boundary<double> const& find(option::Type type, double T, double r, double b, double v)
+  {
+    size_t n = entries_.size();
+    for (size_t k = 1; k <= size_; ++k) {  // most recent first
+      entry const& e = entries_[(next_ + n - k) % n];
+      if (e.type == type && e.T == T && e.r == r && e.b == b && e.v == v) {
+        ++hits_;
+        return e.unit;
+      }
+    }
+    ++misses_;
+    entry& e = entries_[next_];
+    e.type = type; e.T = T; e.r = r; e.b = b; e.v = v;
+    e.unit = type == option::Type::Call ? aux::call_boundary<Policy>(1.0, T, r, b, v)
+                                        : aux::put_boundary<Policy>(1.0, T, r, b, v);
+    next_ = (next_ + 1) % n;
+    size_ = std::min(size_ + 1, n);
+    return e.unit;
+  }
+
+  std::vector<entry> entries_;
+  size_t size_, next_;
+  size_t hits_, misses_;
+};
+
+/**
+ * Chain of options on one underlying and expiry, out[i] is the value at strike X[i]. The
+ * boundary is solved once for a unit strike, or taken from the cache, and scaled per strike.
+ **/
+template <option::Type type, typename Policy>
+auto value(cache<Policy>& c, double S, span<double const> X, double T, double r, double b,
+           double v, span<double> out)
+  -> typename std::enable_if<type == option::Type::Call>::type
+{
+  assert(X.size() == out.size());
+  simd::pack S_(S), T_(T), r_(r), b_(b), v_(v);
+  if (b >= r) {
+    for (size_t i = 0; i < out.size(); i += simd::pack::size)
+      simd::store(out, i, bsm_general::call<Policy>(S_, simd::load(X, i), T_, r_, b_, v_));
+    return;
+  }
+  auto const& u = c.call(T, r, b, v);
+  for (size_t i = 0; i < out.size(); i += simd::pack::size)
+    simd::store(out, i, aux::call<Policy>(u, S_, simd::load(X, i), T_, r_, b_, v_));
+}
+
+template <option::Type type, typename Policy>
+auto value(cache<Policy>& c, double S, span<double const> X, double T, double r, double b,
+           double v, span<double> out)
+  -> typename std::enable_if<type == option::Type::Put>::type
+{
+  assert(X.size() == out.size());
+  simd::pack S_(S), T_(T), r_(r), b_(b), v_(v);
+  auto const& u = c.put(T, r, b, v);
+  for (size_t i = 0; i < out.size(); i += simd::pack::size)
+    simd::store(out, i, aux::put<Policy>(u, S_, simd::load(X, i), T_, r_, b_, v_));
+}
+
+template <option::Type type, typename Policy>
+auto value(cache<Policy>& c, double S, span<double const> X, double T, double r, double b,
+           double v, span<double> call, span<double> put)
+  -> typename std::enable_if<type == option::Type::Both>::type
+{
+  value<option::Type::Call>(c, S, X, T, r, b, v, call);
+  value<option::Type::Put>(c, S, X, T, r, b, v, put);
+}
+
 } } // namespace sfinx::baw
 
@@ -0,0 +1,53 @@
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <vector>
+#include "solver.hpp"
+#include "pv.hpp"
+#include "barone_adesi_whaley.hpp"
+
+using namespace sfinx;
+using namespace sfinx::solver;
+
+/**
+ * Evaluations to |f| < 1e-10 of each solver on the objectives the library solves: the irr of a
+ * 10 year bond, the yield of a 30 year semiannual bond at 85 and the critical price of a
+ * Barone-Adesi-Whaley call. A * marks a secant run that left [a, b] for another root.
+ **/
+int main()
+{
+  std::vector<double> t1, c1, t2, c2;
+  for (int i = 0; i <= 10; ++i) {
+    t1.push_back(i);
+    c1.push_back(i == 0 ? -100 : i == 10 ? 108 : 8);
+  }
+  for (int i = 1; i <= 60; ++i) {
+    t2.push_back(i / 2.0);
+    c2.push_back(i == 60 ? 102.5 : 2.5);
+  }
+  auto irr = [&](double r) { return pv<Flow::Discrete>(t1, c1, r); };
+  auto ytm = [&](double r) { return 85 - pv<Flow::Discrete>(t2, c2, r); };
+  double X = 100, T = .5, r = .08, b = -.04, v = .2;
+  double q = baw::aux::q2((2 * b) / (v * v), (2 * r) / (v * v), 1 - std::exp(-r * T));
+  auto critical = [&](double S) {
+    double d1 = bsm_general::d1(S, X, T, b, v);
+    return S - X - baw::aux::rhs(d1, S, X, T, r, b, v, q);
+  };
+
+  double eps = 1e-10;
+  std::printf("          bisection  secant  illinois  ridders  brent\n");
+  auto row = [&](char const* name, std::function<double(double)> f, double a, double b) {
+    trace tb, ts, ti, tr, tt;
+    double x = bisection(f, std::make_pair(a, b), eps, 1000, &tb).first;
+    bool stray = std::abs(secant(f, std::make_pair(a, b), eps, 1000, &ts).first - x) > 1e-8;
+    illinois(f, std::make_pair(a, b), eps, 1000, &ti);
+    ridders(f, std::make_pair(a, b), eps, 1000, &tr);
+    brent(f, std::make_pair(a, b), eps, 1000, &tt);
+    std::printf("%-10s%9zu%7zu%c%10zu%9zu%7zu\n", name, size_t(tb.evaluations),
+                size_t(ts.evaluations), stray ? '*' : ' ', size_t(ti.evaluations),
+                size_t(tr.evaluations), size_t(tt.evaluations));
+  };
+  row("irr", irr, 0.0, 1.0);
+  row("ytm", ytm, 0.0, 1.0);
+  row("baw S*", critical, X, 10 * X);
+}
@@ -1,7 +1,12 @@
 #pragma once
 #include <type_traits>
 #include <cmath>
+#include <cassert>
+#include <limits>
 #include "math.hpp"
+#include "dual.hpp"
+#include "span.hpp"
+#include "simd.hpp"
 
 namespace sfinx { namespace option {
 
@@ -15,23 +20,134 @@ enum class Exercise
   European, American
 };
 
+/**
+ * Value and sensitivities of one option, theta and charm are per year of calendar time
+ * passing (dV/dt = -dV/dT), rho is with respect to r and carry with respect to b
+ **/
+template <typename Num>
+struct greeks
+{
+  Num value;
+  Num delta, gamma;
+  Num vega, vanna, volga;
+  Num theta, charm;
+  Num rho, carry;
+};
+
+namespace aux {
+
+/**
+ * Greeks of the american approximations from their value, delta and gamma evaluated on
+ * dual numbers seeded along (v, T, r, b). The second order volga is not carried and is NaN.
+ **/
+inline greeks<double> from_dual(ad::dual<4> const& value, ad::dual<4> const& delta,
+                                ad::dual<4> const& gamma)
+{
+  greeks<double> g;
+  g.value = value.v;
+  g.delta = delta.v;
+  g.gamma = gamma.v;
+  g.vega = value.d[0];
+  g.vanna = delta.d[0];
+  g.volga = std::numeric_limits<double>::quiet_NaN();
+  g.theta = -value.d[1];
+  g.charm = -delta.d[1];
+  g.rho = value.d[2];
+  g.carry = value.d[3];
+  return g;
+}
+
+/// Greeks once exercised, the value is phi * (S - X)
+inline greeks<double> exercised(double phi, double S, double X)
+{
+  greeks<double> g = { phi * (S - X), phi, 0, 0, 0, 0, 0, 0, 0, 0 };
+  return g;
+}
+
+} // namespace sfinx::option::aux
+
 } // namespace sfinx::option
 
 /// Generalized Black Scholes Merton
 //
+// The pricers here, in baw and in bs93 take the accuracy tier of the normal distribution,
+// normal::exact, normal::rational or normal::fast, as their first template parameter.
+//
 namespace bsm_general {
 
 namespace aux {
-template <typename Num>
+template <typename Policy = normal::exact, typename Num>
 inline Num call(std::pair<Num, Num> d, Num S, Num X, Num T, Num r, Num b)
 {
-  return S * exp((b - r) * T) * normal_cdf(d.first) - X * exp(-r * T) * normal_cdf(d.second);
+  return S * exp((b - r) * T) * Policy::cdf(d.first) - X * exp(-r * T) * Policy::cdf(d.second);
 }
 
-template <typename Num>
+template <typename Policy = normal::exact, typename Num>
 inline Num put(std::pair<Num, Num> d, Num S, Num X, Num T, Num r, Num b)
 {
-  return X * exp(-r * T) * normal_cdf(-d.second) - S * exp((b - r) * T) * normal_cdf(-d.first);
+  return X * exp(-r * T) * Policy::cdf(-d.second) - S * exp((b - r) * T) * Policy::cdf(-d.first);
+}
+
+/// Terms shared by the value and all the greeks, evaluated once
+template <typename Num, typename Policy = normal::exact>
+struct shared
+{
+  Num sT, d1, d2, n1, carry, df;
+
+  shared(Num S, Num X, Num T, Num r, Num b, Num v)
+    : sT(sqrt(T)), d1((log(S / X) + (b + v * v / 2) * T) / (v * sT)), d2(d1 - v * sT),
+      n1(Policy::pdf(d1)), carry(exp((b - r) * T)), df(exp(-r * T))
+  {}
+};
+
+/// phi is 1 for a call, -1 for a put
+template <typename Num, typename Policy>
+option::greeks<Num> greeks(shared<Num, Policy> const& s, Num phi, Num S, Num X, Num T, Num r, Num b, Num v)
+{
+  Num N1 = Policy::cdf(phi * s.d1), N2 = Policy::cdf(phi * s.d2);
+  Num Se = S * s.carry, Xd = X * s.df;
+  option::greeks<Num> g;
+  g.value = phi * (Se * N1 - Xd * N2);
+  g.delta = phi * s.carry * N1;
+  g.gamma = s.carry * s.n1 / (S * v * s.sT);
+  g.vega = Se * s.n1 * s.sT;
+  g.vanna = -s.carry * s.n1 * s.d2 / v;
+  g.volga = g.vega * s.d1 * s.d2 / v;
+  g.theta = -Se * s.n1 * v / (2 * s.sT) - phi * ((b - r) * Se * N1 + r * Xd * N2);
+  g.charm = -s.carry * (s.n1 * (b / (v * s.sT) - s.d2 / (2 * T)) + phi * (b - r) * N1);
+  g.rho = -T * g.value;
+  g.carry = phi * T * Se * N1;
+  return g;
+}
+
+inline void store(option::greeks<span<double>> const& out, size_t i,
+                  option::greeks<double> const& g)
+{
+  out.value[i] = g.value;
+  out.delta[i] = g.delta;
+  out.gamma[i] = g.gamma;
+  out.vega[i] = g.vega;
+  out.vanna[i] = g.vanna;
+  out.volga[i] = g.volga;
+  out.theta[i] = g.theta;
+  out.charm[i] = g.charm;
+  out.rho[i] = g.rho;
+  out.carry[i] = g.carry;
+}
+
+template <typename Num>
+inline void store(option::greeks<span<double>> const& out, size_t i, option::greeks<Num> const& g)
+{
+  simd::store(out.value, i, g.value);
+  simd::store(out.delta, i, g.delta);
+  simd::store(out.gamma, i, g.gamma);
+  simd::store(out.vega, i, g.vega);
+  simd::store(out.vanna, i, g.vanna);
+  simd::store(out.volga, i, g.volga);
+  simd::store(out.theta, i, g.theta);
+  simd::store(out.charm, i, g.charm);
+  simd::store(out.rho, i, g.rho);
+  simd::store(out.carry, i, g.carry);
 }
 } // namespace sfinx::bsm_general::aux
 
@@ -57,19 +173,99 @@ inline std::pair<Num, Num> d(Num S, Num X, Num T, Num r, Num b, Num v)
 /**
  * Call option 
  **/
-template <typename Num>
+template <typename Policy = normal::exact, typename Num>
 inline Num call(Num S, Num X, Num T, Num r, Num b, Num v)
 {
-  return aux::call(d(S, X, T, r, b, v), S, X, T, r, b);
+  return aux::call<Policy>(d(S, X, T, r, b, v), S, X, T, r, b);
 }
 
 /**
  * Put option
  **/
-template <typename Num>
+template <typename Policy = normal::exact, typename Num>
 inline Num put(Num S, Num X, Num T, Num r, Num b, Num v)
 {
-  return aux::put(d(S, X, T, r, b, v), S, X, T, r, b);
+  return aux::put<Policy>(d(S, X, T, r, b, v), S, X, T, r, b);
+}
+
+/**
+ * Value and all greeks from one evaluation of d1, d2, the density and the discount factors
+ **/
+template <option::Type type, typename Policy = normal::exact, typename Num>
+auto greeks(Num S, Num X, Num T, Num r, Num b, Num v)
+  -> typename std::enable_if<type != option::Type::Both, option::greeks<Num>>::type
+{
+  aux::shared<Num, Policy> s(S, X, T, r, b, v);
+  return aux::greeks(s, Num(type == option::Type::Call ? 1 : -1), S, X, T, r, b, v);
+}
+
+template <option::Type type, typename Policy = normal::exact, typename Num>
+auto greeks(Num S, Num X, Num T, Num r, Num b, Num v)
+  -> typename std::enable_if<type == option::Type::Both,
+                             std::pair<option::greeks<Num>, option::greeks<Num>>>::type
+{
+  aux::shared<Num, Policy> s(S, X, T, r, b, v);
+  return std::make_pair(aux::greeks(s, Num(1), S, X, T, r, b, v),
+                        aux::greeks(s, Num(-1), S, X, T, r, b, v));
+}
+
+/**
+ * Batch call/put over structure-of-arrays inputs, out[i] = call(S[i], X[i], T[i], r[i], b[i], v[i]).
+ * The scalar templates are run on simd::pack, so results match them to within 1e-14 * X
+ * absolute, the difference being the vector exp/log/erfc.
+ **/
+template <typename Policy = normal::exact>
+void call(span<double const> S, span<double const> X, span<double const> T,
+         span<double const> r, span<double const> b, span<double const> v, span<double> out)
+{
+  assert(S.size() == out.size() && X.size() == out.size() && T.size() == out.size()
+         && r.size() == out.size() && b.size() == out.size() && v.size() == out.size());
+  for (size_t i = 0; i < out.size(); i += simd::pack::size)
+    simd::store(out, i, call<Policy>(simd::load(S, i), simd::load(X, i), simd::load(T, i),
+                                     simd::load(r, i), simd::load(b, i), simd::load(v, i)));
+}
+
+template <typename Policy = normal::exact>
+void put(span<double const> S, span<double const> X, span<double const> T,
+         span<double const> r, span<double const> b, span<double const> v, span<double> out)
+{
+  assert(S.size() == out.size() && X.size() == out.size() && T.size() == out.size()
+         && r.size() == out.size() && b.size() == out.size() && v.size() == out.size());
+  for (size_t i = 0; i < out.size(); i += simd::pack::size)
+    simd::store(out, i, put<Policy>(simd::load(S, i), simd::load(X, i), simd::load(T, i),
+                                    simd::load(r, i), simd::load(b, i), simd::load(v, i)));
+}
+
+/**
+ * Batch greeks, each field of out is a column of results
+ **/
+template <option::Type type, typename Policy = normal::exact>
+auto greeks(span<double const> S, span<double const> X, span<double const> T,
+            span<double const> r, span<double const> b, span<double const> v,
+            option::greeks<span<double>> const& out)
+  -> typename std::enable_if<type != option::Type::Both>::type
+{
+  size_t n = S.size();
+  assert(X.size() == n && T.size() == n && r.size() == n && b.size() == n && v.size() == n);
+  for (size_t i = 0; i < n; i += simd::pack::size)
+    aux::store(out, i, greeks<type, Policy>(simd::load(S, i), simd::load(X, i), simd::load(T, i),
+                                            simd::load(r, i), simd::load(b, i), simd::load(v, i)));
+}
+
+template <option::Type type, typename Policy = normal::exact>
+auto greeks(span<double const> S, span<double const> X, span<double const> T,
+            span<double const> r, span<double const> b, span<double const> v,
+            option::greeks<span<double>> const& call, option::greeks<span<double>> const& put)
+  -> typename std::enable_if<type == option::Type::Both>::type
+{
+  size_t n = S.size();
+  assert(X.size() == n && T.size() == n && r.size() == n && b.size() == n && v.size() == n);
+  for (size_t i = 0; i < n; i += simd::pack::size) {
+    auto cp = greeks<type, Policy>(simd::load(S, i), simd::load(X, i), simd::load(T, i),
+                                   simd::load(r, i), simd::load(b, i), simd::load(v, i));
+    aux::store(call, i, cp.first);
+    aux::store(put, i, cp.second);
+  }
 }
 
 } // namespace bsm_general
@@ -80,16 +276,16 @@ inline Num put(Num S, Num X, Num T, Num r, Num b, Num v)
 namespace bs {
 
 namespace aux {
-template <typename Num>
+template <typename Policy = normal::exact, typename Num>
 inline Num call(std::pair<Num, Num> d, Num S, Num X, Num T, Num r)
 {
-  return S * normal_cdf(d.first) - X * exp(-r * T) * normal_cdf(d.second);
+  return S * Policy::cdf(d.first) - X * exp(-r * T) * Policy::cdf(d.second);
 }
 
-template <typename Num>
+template <typename Policy = normal::exact, typename Num>
 inline Num put(std::pair<Num, Num> d, Num S, Num X, Num T, Num r)
 {
-  return X * exp(-r * T) * normal_cdf(-d.second) - S * normal_cdf(-d.first);
+  return X * exp(-r * T) * Policy::cdf(-d.second) - S * Policy::cdf(-d.first);
 }
 
 } // namespace sfinx::bs::aux
@@ -123,129 +319,213 @@ inline std::pair<Num, Num> d(Num S, Num X, Num T, Num r, Num v)
 /**
  * Call option value 
  **/
-template <typename Num>
+template <typename Policy = normal::exact, typename Num>
 Num call(Num S, Num X, Num T, Num r, Num v)
 {
-  return aux::call(d(S, X, T, r, v), S, X, T, r);
+  return aux::call<Policy>(d(S, X, T, r, v), S, X, T, r);
 }
 
 /**
  * Put option value
  **/
-template <typename Num>
+template <typename Policy = normal::exact, typename Num>
 Num put(Num S, Num X, Num T, Num r, Num v)
 {
-  return aux::put(d(S, X, T, r, v), S, X, T, r);
+  return aux::put<Policy>(d(S, X, T, r, v), S, X, T, r);
 }
 
-template <option::Type type, typename Num>
+template <option::Type type, typename Policy = normal::exact, typename Num>
 auto value(Num S, Num X, Num T, Num r, Num v)
   -> typename std::enable_if<type == option::Type::Both, std::pair<Num, Num>>::type
 {
   auto d = bs::d(S, X, T, r, v);
-  return std::make_pair(aux::call(d, S, X, T, r), aux::put(d, S, X, T, r));
+  return std::make_pair(aux::call<Policy>(d, S, X, T, r), aux::put<Policy>(d, S, X, T, r));
 }
 
-template <option::Type type, typename Num>
+template <option::Type type, typename Policy = normal::exact, typename Num>
 auto value(Num S, Num X, Num T, Num r, Num v)
   -> typename std::enable_if<type == option::Type::Call, Num>::type
 {
-  return call(S, X, T, r, v);
+  return call<Policy>(S, X, T, r, v);
 }
 
-template <option::Type type, typename Num>
+template <option::Type type, typename Policy = normal::exact, typename Num>
 auto value(Num S, Num X, Num T, Num r, Num v)
   -> typename std::enable_if<type == option::Type::Put, Num>::type
 {
-  return put(S, X, T, r, v);
+  return put<Policy>(S, X, T, r, v);
+}
+
+/**
+ * Batch value over structure-of-arrays inputs, see bsm_general::call for accuracy
+ **/
+template <option::Type type, typename Policy = normal::exact>
+auto value(span<double const> S, span<double const> X, span<double const> T,
+           span<double const> r, span<double const> v, span<double> out)
+  -> typename std::enable_if<type != option::Type::Both>::type
+{
+  assert(S.size() == out.size() && X.size() == out.size() && T.size() == out.size()
+         && r.size() == out.size() && v.size() == out.size());
+  for (size_t i = 0; i < out.size(); i += simd::pack::size)
+    simd::store(out, i, value<type, Policy>(simd::load(S, i), simd::load(X, i), simd::load(T, i),
+                                            simd::load(r, i), simd::load(v, i)));
+}
+
+template <option::Type type, typename Policy = normal::exact>
+auto value(span<double const> S, span<double const> X, span<double const> T,
+           span<double const> r, span<double const> v, span<double> call, span<double> put)
+  -> typename std::enable_if<type == option::Type::Both>::type
+{
+  assert(S.size() == call.size() && X.size() == call.size() && T.size() == call.size()
+         && r.size() == call.size() && v.size() == call.size() && put.size() == call.size());
+  for (size_t i = 0; i < call.size(); i += simd::pack::size) {
+    auto cp = value<type, Policy>(simd::load(S, i), simd::load(X, i), simd::load(T, i),
+                                  simd::load(r, i), simd::load(v, i));
+    simd::store(call, i, cp.first);
+    simd::store(put, i, cp.second);
+  }
+}
+
+/**
+ * Value and all greeks in one pass, b = r so rho is the total rate sensitivity and carry is zero
+ **/
+template <option::Type type, typename Policy = normal::exact, typename Num>
+auto greeks(Num S, Num X, Num T, Num r, Num v)
+  -> typename std::enable_if<type != option::Type::Both, option::greeks<Num>>::type
+{
+  auto g = bsm_general::greeks<type, Policy>(S, X, T, r, r, v);
+  g.rho = g.rho + g.carry;
+  g.carry = Num(0);
+  return g;
+}
+
+template <option::Type type, typename Policy = normal::exact, typename Num>
+auto greeks(Num S, Num X, Num T, Num r, Num v)
+  -> typename std::enable_if<type == option::Type::Both,
+                             std::pair<option::greeks<Num>, option::greeks<Num>>>::type
+{
+  auto cp = bsm_general::greeks<type, Policy>(S, X, T, r, r, v);
+  cp.first.rho = cp.first.rho + cp.first.carry;
+  cp.second.rho = cp.second.rho + cp.second.carry;
+  cp.first.carry = cp.second.carry = Num(0);
+  return cp;
+}
+
+template <option::Type type, typename Policy = normal::exact>
+auto greeks(span<double const> S, span<double const> X, span<double const> T,
+            span<double const> r, span<double const> v, option::greeks<span<double>> const& out)
+  -> typename std::enable_if<type != option::Type::Both>::type
+{
+  size_t n = S.size();
+  assert(X.size() == n && T.size() == n && r.size() == n && v.size() == n);
+  for (size_t i = 0; i < n; i += simd::pack::size)
+    bsm_general::aux::store(out, i, greeks<type, Policy>(simd::load(S, i), simd::load(X, i),
+                                                         simd::load(T, i), simd::load(r, i),
+                                                         simd::load(v, i)));
+}
+
+template <option::Type type, typename Policy = normal::exact>
+auto greeks(span<double const> S, span<double const> X, span<double const> T,
+            span<double const> r, span<double const> v,
+            option::greeks<span<double>> const& call, option::greeks<span<double>> const& put)
+  -> typename std::enable_if<type == option::Type::Both>::type
+{
+  size_t n = S.size();
+  assert(X.size() == n && T.size() == n && r.size() == n && v.size() == n);
+  for (size_t i = 0; i < n; i += simd::pack::size) {
+    auto cp = greeks<type, Policy>(simd::load(S, i), simd::load(X, i), simd::load(T, i),
+                                   simd::load(r, i), simd::load(v, i));
+    bsm_general::aux::store(call, i, cp.first);
+    bsm_general::aux::store(put, i, cp.second);
+  }
 }
 
 /**
  * Greeks
  * */
-template <option::Type type, typename Num>
+template <option::Type type, typename Policy = normal::exact, typename Num>
 auto delta(Num S, Num X, Num T, Num r, Num v)
   -> typename std::enable_if<type == option::Type::Call, Num>::type
 {
-  return normal_cdf(bs::d1(S, X, T, r, v));
+  return Policy::cdf(bs::d1(S, X, T, r, v));
 }
 
-template <option::Type type, typename Num>
+template <option::Type type, typename Policy = normal::exact, typename Num>
 auto delta(Num S, Num X, Num T, Num r, Num v)
   -> typename std::enable_if<type == option::Type::Put, Num>::type
 {
-  return normal_cdf(bs::d1(S, X, T, r, v)) - 1;
+  return Policy::cdf(bs::d1(S, X, T, r, v)) - 1;
 }
 
-template <option::Type type, typename Num>
+template <option::Type type, typename Policy = normal::exact, typename Num>
 auto delta(Num S, Num X, Num T, Num r, Num v)
   -> typename std::enable_if<type == option::Type::Both, std::pair<Num, Num>>::type
 {
-  Num d = delta<option::Type::Call>(S, X, T, r, v);
+  Num d = delta<option::Type::Call, Policy>(S, X, T, r, v);
   return std::make_pair(d, d - 1);
 }
 
-template <typename Num>
+template <typename Policy = normal::exact, typename Num>
 inline Num gamma(Num S, Num X, Num T, Num r, Num v)
 {
-  return normal_pdf(bs::d1(S, X, T, r, v)) / (S * v * sqrt(T));
+  return Policy::pdf(bs::d1(S, X, T, r, v)) / (S * v * sqrt(T));
 }
 
-template <typename Num>
+template <typename Policy = normal::exact, typename Num>
 inline Num vega(Num S, Num X, Num T, Num r, Num v)
 {
-  return S * normal_pdf(bs::d1(S, X, T, r, v)) * sqrt(T);
+  return S * Policy::pdf(bs::d1(S, X, T, r, v)) * sqrt(T);
 }
 
-template <option::Type type, typename Num>
+template <option::Type type, typename Policy = normal::exact, typename Num>
 auto theta(Num S, Num X, Num T, Num r, Num v)
   -> typename std::enable_if<type == option::Type::Call, Num>::type
 {
   Num d1 = bs::d1(S, X, T, r, v);
   Num d2 = bs::d2(d1, T, v);
-  return -S * normal_pdf(d1) * v / (2 * sqrt(T)) - r * X * exp(-r * T) * normal_cdf(d2);
+  return -S * Policy::pdf(d1) * v / (2 * sqrt(T)) - r * X * exp(-r * T) * Policy::cdf(d2);
 }
 
-template <option::Type type, typename Num>
+template <option::Type type, typename Policy = normal::exact, typename Num>
 auto theta(Num S, Num X, Num T, Num r, Num v)
   -> typename std::enable_if<type == option::Type::Put, Num>::type
 {
   Num d1 = bs::d1(S, X, T, r, v);
   Num d2 = bs::d2(d1, T, v);
-  return -S * normal_pdf(d1) * v / (2 * sqrt(T)) + r * X * exp(-r * T) * normal_cdf(-d2);
+  return -S * Policy::pdf(d1) * v / (2 * sqrt(T)) + r * X * exp(-r * T) * Policy::cdf(-d2);
 }
 
-template <option::Type type, typename Num>
+template <option::Type type, typename Policy = normal::exact, typename Num>
 auto theta(Num S, Num X, Num T, Num r, Num v)
   -> typename std::enable_if<type == option::Type::Both, std::pair<Num, Num>>::type
 {
   Num d1 = bs::d1(S, X, T, r, v);
   Num d2 = bs::d2(d1, T, v);
-  Num t1 = -S * normal_pdf(d1) * v / (2 * sqrt(T)), t2 = r * X * exp(-r * T);
-  return std::make_pair(t1 - t2 * normal_cdf(d2), t1 + t2 * normal_cdf(-d2));
+  Num t1 = -S * Policy::pdf(d1) * v / (2 * sqrt(T)), t2 = r * X * exp(-r * T);
+  return std::make_pair(t1 - t2 * Policy::cdf(d2), t1 + t2 * Policy::cdf(-d2));
 }
 
-template <option::Type type, typename Num>
+template <option::Type type, typename Policy = normal::exact, typename Num>
 auto rho(Num S, Num X, Num T, Num r, Num v)
   -> typename std::enable_if<type == option::Type::Call, Num>::type
 {
-  return X * T * exp(-r * T) * normal_cdf(bs::d2(S, X, T, r, v));
+  return X * T * exp(-r * T) * Policy::cdf(bs::d2(S, X, T, r, v));
 }
 
-template <option::Type type, typename Num>
+template <option::Type type, typename Policy = normal::exact, typename Num>
 auto rho(Num S, Num X, Num T, Num r, Num v)
   -> typename std::enable_if<type == option::Type::Put, Num>::type
 {
-  return -X * T * exp(-r * T) * normal_cdf(-bs::d2(S, X, T, r, v));
+  return -X * T * exp(-r * T) * Policy::cdf(-bs::d2(S, X, T, r, v));
 }
 
-template <option::Type type, typename Num>
+template <option::Type type, typename Policy = normal::exact, typename Num>
 auto rho(Num S, Num X, Num T, Num r, Num v)
   -> typename std::enable_if<type == option::Type::Both, std::pair<Num, Num>>::type
 {
   Num d2 = bs::d2(S, X, T, r, v);
   Num t = X * T * exp(-r * T);
-  return std::make_pair(t * normal_cdf(d2), -t * normal_cdf(-d2));
+  return std::make_pair(t * Policy::cdf(d2), -t * Policy::cdf(-d2));
 }
 
 } // namespace bs
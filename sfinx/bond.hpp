@@ -1,7 +1,9 @@
 #pragma once
 #include <functional>
+#include <iterator>
 #include "discount_factor.hpp"
 #include "pv.hpp"
+#include "irr.hpp"
 #include "solver.hpp"
 #include "math.hpp"
 
@@ -13,33 +15,66 @@ Ret bond_price(T const& times, U const& amounts, Ret r)
   return pv<F>(times, amounts, r);
 }
 
+/// Yield of the bond at price, see irr; annually compounded for Discrete
 template <Flow F, typename T, typename U>
-double ytm(T const& times, U const& amounts, double price)
+double ytm(T const& times, U const& amounts, double price, solver::trace* tr = nullptr)
 {
-  using namespace std::placeholders;
-  auto range = std::make_pair(0.0, 1.0);
-  double eps = 1.0e-5;
-  auto f = [&](double r){ return price - pv<F>(times, amounts, r); };
-  auto res = solver::bisection(f, range, eps);
-  return res.second <= eps ? res.first : std::numeric_limits<double>::quiet_NaN();
+  return aux::solve_yield<F>(times, amounts, price, tr);
+}
+
+/// Price and rate sensitivities of a bond at one yield, dv01 is the price change per basis point
+template <typename Num>
+struct bond_measures
+{
+  Num yield, price, macaulay_duration, modified_duration, convexity, dv01;
+};
+
+/**
+ * All measures from one traversal of the cashflows with one discount factor per cashflow,
+ * annually compounded yield r for Discrete and continuous for Continuous.
+ **/
+template <Flow F, typename T, typename U, typename Num>
+bond_measures<Num> bond_analytics(T const& times, U const& amounts, Num r)
+{
+  Num B = 0, D = 0, C = 0;
+  auto ti = std::begin(times);
+  auto ci = std::begin(amounts);
+  for (; ti != std::end(times) && ci != std::end(amounts); ++ti, ++ci) {
+    double t = *ti;
+    Num v = *ci * (F == Flow::Discrete ? discount_factor(r, Num(t), 1) : discount_factor(r, Num(t)));
+    B = B + v;
+    D = D + t * v;
+    C = C + t * (F == Flow::Discrete ? t + 1 : t) * v;
+  }
+  bond_measures<Num> m;
+  m.yield = r;
+  m.price = B;
+  m.macaulay_duration = D / B;
+  m.modified_duration = F == Flow::Discrete ? m.macaulay_duration / (1 + r) : m.macaulay_duration;
+  m.convexity = F == Flow::Discrete ? C / (B * (1 + r) * (1 + r)) : C / B;
+  m.dv01 = m.modified_duration * B * 1.0e-4;
+  return m;
+}
+
+/// The measures at the yield of price, solved once
+template <Flow F, typename T, typename U>
+bond_measures<double> bond_analytics_at_price(T const& times, U const& amounts, double price)
+{
+  return bond_analytics<F>(times, amounts, ytm<F>(times, amounts, price));
 }
 
 template <Flow F, typename T, typename U>
 auto bond_duration(T const& times, U const& amounts, double r)
   -> typename std::enable_if<F == Flow::Discrete, double>::type
 {
-  auto f = [r](double t, double c) { return t * c * discount_factor(r, t, 1); };
-  double pv_time = inner_product(0.0, times, amounts, f);
-  return pv_time / pv<F>(times, amounts, r);
+  return bond_analytics<F>(times, amounts, r).macaulay_duration;
 }
 
 template <Flow F, typename T, typename U, typename Ret>
 auto bond_duration(T const& times, U const& amounts, Ret r)
   -> typename std::enable_if<F == Flow::Continuous, Ret>::type
 {
-  auto f = [r](Ret t, Ret c) { return t * c * discount_factor(r, t); };
-  double pv_time = inner_product(0.0, times, amounts, f);
-  return pv_time / pv<F>(times, amounts, r);
+  return bond_analytics<F>(times, amounts, r).macaulay_duration;
 }
 
 template <Flow F, typename T, typename U>
@@ -60,20 +95,14 @@ template <Flow F, typename T, typename U>
 auto bond_convexity(T const& times, U const& amounts, double r)
   -> typename std::enable_if<F == Flow::Discrete, double>::type
 {
-  auto f = [r](double t, double c) { return c * t * (t + 1) * discount_factor(r, t, 1); };
-  double Cx = inner_product(0.0, times, amounts, f);
-  double B = bond_price<F>(times, amounts, r);
-  return (Cx / std::pow(1 + r, 2)) / B;
+  return bond_analytics<F>(times, amounts, r).convexity;
 }
 
 template <Flow F, typename T, typename U, typename Ret>
 auto bond_convexity(T const& times, U const& amounts, Ret r)
   -> typename std::enable_if<F == Flow::Continuous, Ret>::type
 {
-  auto f = [r](Ret t, Ret c) { return c * t * t * discount_factor(r, t); };
-  double C = inner_product(0.0, times, amounts, f);
-  double B = bond_price<F>(times, amounts, r);
-  return C / B;
+  return bond_analytics<F>(times, amounts, r).convexity;
 }
 
 } // namespace sfinx
@@ -0,0 +1,183 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include "span.hpp"
+#include "memory.hpp"
+#include "pv.hpp"
+#include "bond.hpp"
+#include "thread_pool.hpp"
+
+namespace sfinx {
+
+/**
+ * Cashflows of many instruments in compressed sparse row form: the flows of instrument k are
+ * times[offsets[k], offsets[k + 1]) and the same range of amounts, all instruments in two flat
+ * arrays. Alloc sets the storage of the flows, aligned_cashflow_book puts them on 64 byte
+ * boundaries.
+ **/
+template <typename Alloc = std::allocator<double>>
+class basic_cashflow_book
+{
+public:
+  basic_cashflow_book() : offsets_(1, 0) {}
+
+  void reserve(size_t instruments, size_t flows)
+  {
+    offsets_.reserve(instruments + 1);
+    times_.reserve(flows);
+    amounts_.reserve(flows);
+  }
+
+  /// Append an instrument, returns its index
+  template <typename T, typename U>
+  size_t add(T const& times, U const& amounts)
+  {
+    auto t = std::begin(times);
+    auto c = std::begin(amounts);
+    for (; t != std::end(times) && c != std::end(amounts); ++t, ++c) {
+      times_.push_back(*t);
+      amounts_.push_back(*c);
+    }
+    offsets_.push_back(times_.size());
+    return size() - 1;
+  }
+
+  size_t size() const { return offsets_.size() - 1; }
+  size_t flows() const { return times_.size(); }
+
+  span<double const> times(size_t k) const
+  {
+    return span<double const>(times_.data() + offsets_[k], offsets_[k + 1] - offsets_[k]);
+  }
+
+  span<double const> amounts(size_t k) const
+  {
+    return span<double const>(amounts_.data() + offsets_[k], offsets_[k + 1] - offsets_[k]);
+  }
+
+  span<double const> times() const { return times_; }
+  span<double const> amounts() const { return amounts_; }
+  span<size_t const> offsets() const { return offsets_; }
+
+private:
+  std::vector<double, Alloc> times_, amounts_;
+  std::vector<size_t> offsets_;
+};
+
+typedef basic_cashflow_book<> cashflow_book;
+typedef basic_cashflow_book<aligned_allocator<double, 64>> aligned_cashflow_book;
+
+/**
+ * The distinct cashflow times of a book and the slot of each flow among them. When the
+ * instruments share one curve its discount factors are computed once per distinct time and
+ * every flow is a lookup, which for a universe on a common payment calendar is a few hundred
+ * exp calls instead of one per flow.
+ **/
+class discount_table
+{
+public:
+  template <typename Alloc>
+  explicit discount_table(basic_cashflow_book<Alloc> const& book)
+    : times_(book.times().begin(), book.times().end()), slots_(book.flows())
+  {
+    std::sort(times_.begin(), times_.end());
+    times_.erase(std::unique(times_.begin(), times_.end()), times_.end());
+    span<double const> t = book.times();
+    for (size_t j = 0; j < t.size(); ++j)
+      slots_[j] = uint32_t(std::lower_bound(times_.begin(), times_.end(), t[j]) - times_.begin());
+  }
+
+  span<double const> times() const { return times_; }
+  span<uint32_t const> slots() const { return slots_; }
+
+  /// Discount factors at the distinct times from curve(t)
+  template <typename Curve>
+  std::vector<double> discount(Curve const& curve) const
+  {
+    std::vector<double> df(times_.size());
+    for (size_t i = 0; i < times_.size(); ++i)
+      df[i] = curve(times_[i]);
+    return df;
+  }
+
+private:
+  std::vector<double> times_;
+  std::vector<uint32_t> slots_;
+};
+
+namespace aux {
+
+/// Instruments per task, enough flows to amortize the scheduling and few enough to balance
+size_t const book_chunk = 1024;
+
+template <typename F>
+void for_chunks(size_t n, thread_pool& pool, F const& f)
+{
+  pool.parallel_for((n + book_chunk - 1) / book_chunk, [&](size_t c) {
+    for (size_t k = c * book_chunk, e = std::min(n, k + book_chunk); k < e; ++k)
+      f(k);
+  });
+}
+
+template <typename Num>
+void store(bond_measures<span<double>> const& out, size_t k, bond_measures<Num> const& m)
+{
+  if (!out.yield.empty()) out.yield[k] = m.yield;
+  if (!out.price.empty()) out.price[k] = m.price;
+  if (!out.macaulay_duration.empty()) out.macaulay_duration[k] = m.macaulay_duration;
+  if (!out.modified_duration.empty()) out.modified_duration[k] = m.modified_duration;
+  if (!out.convexity.empty()) out.convexity[k] = m.convexity;
+  if (!out.dv01.empty()) out.dv01[k] = m.dv01;
+}
+
+} // namespace sfinx::aux
+
+/**
+ * Price and risk columns of every instrument of the book at its yield, one traversal of the
+ * flows of each. Columns left empty in out are not written. Chunks of instruments are spread
+ * over the pool, each writes its own rows.
+ **/
+template <Flow F, typename Alloc>
+void bond_analytics(basic_cashflow_book<Alloc> const& book, span<double const> yield,
+                    bond_measures<span<double>> const& out, thread_pool& pool)
+{
+  assert(yield.size() == book.size());
+  aux::for_chunks(book.size(), pool, [&](size_t k) {
+    aux::store(out, k, bond_analytics<F>(book.times(k), book.amounts(k), yield[k]));
+  });
+}
+
+/// The columns at the yield of each price, one yield solve per instrument
+template <Flow F, typename Alloc>
+void bond_analytics_at_price(basic_cashflow_book<Alloc> const& book, span<double const> price,
+                             bond_measures<span<double>> const& out, thread_pool& pool)
+{
+  assert(price.size() == book.size());
+  aux::for_chunks(book.size(), pool, [&](size_t k) {
+    aux::store(out, k, bond_analytics_at_price<F>(book.times(k), book.amounts(k), price[k]));
+  });
+}
+
+/// Prices of every instrument off one curve, df holds its discount factors at table.times()
+template <typename Alloc>
+void bond_price(basic_cashflow_book<Alloc> const& book, discount_table const& table,
+                span<double const> df, span<double> price, thread_pool& pool)
+{
+  assert(df.size() == table.times().size() && price.size() == book.size());
+  span<double const> amounts = book.amounts();
+  span<uint32_t const> slots = table.slots();
+  span<size_t const> offsets = book.offsets();
+  aux::for_chunks(book.size(), pool, [&](size_t k) {
+    double p = 0;
+    for (size_t j = offsets[k]; j < offsets[k + 1]; ++j)
+      p += amounts[j] * df[slots[j]];
+    price[k] = p;
+  });
+}
+
+} // namespace sfinx
@@ -0,0 +1,182 @@
+#pragma once
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include "pv.hpp"
+#include "bond.hpp"
+
+namespace sfinx {
+
+class coupon_schedule;
+
+namespace aux {
+
+/// Lazy view of the times or the amounts of a schedule, computed from the index on access
+template <bool amounts>
+class schedule_range
+{
+public:
+  class iterator
+  {
+  public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef double value_type;
+    typedef ptrdiff_t difference_type;
+    typedef double const* pointer;
+    typedef double reference;
+
+    iterator(coupon_schedule const* s, size_t i) : s_(s), i_(i) {}
+    double operator*() const;
+    iterator& operator++() { ++i_; return *this; }
+    iterator operator++(int) { iterator it = *this; ++i_; return it; }
+    bool operator==(iterator const& o) const { return i_ == o.i_; }
+    bool operator!=(iterator const& o) const { return i_ != o.i_; }
+
+  private:
+    coupon_schedule const* s_;
+    size_t i_;
+  };
+
+  explicit schedule_range(coupon_schedule const& s) : s_(&s) {}
+
+  iterator begin() const { return iterator(s_, 0); }
+  iterator end() const;
+  size_t size() const;
+  double operator[](size_t i) const { return *iterator(s_, i); }
+  coupon_schedule const& schedule() const { return *s_; }
+
+private:
+  coupon_schedule const* s_;
+};
+
+} // namespace sfinx::aux
+
+typedef aux::schedule_range<false> coupon_times;
+typedef aux::schedule_range<true> coupon_amounts;
+
+/**
+ * Regular fixed coupon bond: frequency coupons a year of face * coupon / frequency, the last
+ * one at maturity with the face. When maturity is not a whole number of periods the first
+ * coupon comes after a short stub. Nothing is materialized, times() and amounts() are lazy
+ * ranges that work with every (times, amounts) function; pv, pv_derivatives and
+ * bond_analytics recognize them and use the geometric structure of the discount factors.
+ * Those overloads are in aux next to the ranges, so argument dependent lookup finds them from
+ * ytm, bond_price, bond_duration and bond_convexity, defined before this header.
+ **/
+class coupon_schedule
+{
+public:
+  coupon_schedule(double face, double coupon, unsigned frequency, double maturity)
+    : face_(face), coupon_(face * coupon / frequency), period_(1.0 / frequency),
+      size_(size_t(std::ceil(maturity * frequency - 1e-9))), maturity_(maturity)
+  {
+    assert(frequency > 0 && size_ > 0);
+  }
+
+  size_t size() const { return size_; }
+  double face() const { return face_; }
+  double coupon() const { return coupon_; }    // per period
+  double period() const { return period_; }
+  double maturity() const { return maturity_; }
+  double first() const { return time(0); }
+
+  double time(size_t i) const { return maturity_ - double(size_ - 1 - i) * period_; }
+  double amount(size_t i) const { return i + 1 == size_ ? coupon_ + face_ : coupon_; }
+
+  coupon_times times() const { return coupon_times(*this); }
+  coupon_amounts amounts() const { return coupon_amounts(*this); }
+
+private:
+  double face_, coupon_, period_;
+  size_t size_;
+  double maturity_;
+};
+
+namespace aux {
+
+template <bool amounts>
+double schedule_range<amounts>::iterator::operator*() const
+{
+  return amounts ? s_->amount(i_) : s_->time(i_);
+}
+
+template <bool amounts>
+typename schedule_range<amounts>::iterator schedule_range<amounts>::end() const
+{
+  return iterator(s_, s_->size());
+}
+
+template <bool amounts>
+size_t schedule_range<amounts>::size() const
+{
+  return s_->size();
+}
+
+/// Log growth per year, the discount factor at t is exp(-L t)
+template <Flow F>
+double log_growth(double r)
+{
+  return F == Flow::Discrete ? std::log1p(r) : r;
+}
+
+/**
+ * O(1) present value of a schedule: the coupons are d1 * q^i with q the discount factor of a
+ * period and d1 that of the first coupon, an annuity summed in closed form. expm1 keeps the
+ * annuity accurate down to a zero rate.
+ **/
+template <Flow F>
+double pv(coupon_times const& times, coupon_amounts const& amounts, double r)
+{
+  coupon_schedule const& s = times.schedule();
+  assert(&s == &amounts.schedule());
+  double L = aux::log_growth<F>(r), n = double(s.size());
+  double annuity = L == 0 ? n : std::expm1(-n * L * s.period()) / std::expm1(-L * s.period());
+  return s.coupon() * exp(-L * s.first()) * annuity + s.face() * exp(-L * s.maturity());
+}
+
+/// pv and its rate derivatives by the recurrence df_i+1 = q df_i, two exp calls in all
+template <Flow F>
+pv_sensitivities pv_derivatives(coupon_times const& times, coupon_amounts const& amounts,
+                                double r)
+{
+  coupon_schedule const& s = times.schedule();
+  assert(&s == &amounts.schedule());
+  double L = aux::log_growth<F>(r), q = exp(-L * s.period()), df = exp(-L * s.first());
+  double g = F == Flow::Discrete ? 1 / (1 + r) : 1;
+  pv_sensitivities res = { 0, 0, 0 };
+  for (size_t i = 0; i < s.size(); ++i, df *= q) {
+    double t = s.time(i), v = s.amount(i) * df;
+    res.pv += v;
+    res.dpv -= t * v;
+    res.d2pv += t * (F == Flow::Discrete ? t + 1 : t) * v;
+  }
+  res.dpv *= g;
+  res.d2pv *= g * g;
+  return res;
+}
+
+/// bond_analytics by the same recurrence
+template <Flow F>
+bond_measures<double> bond_analytics(coupon_times const& times, coupon_amounts const& amounts,
+                                     double r)
+{
+  pv_sensitivities d = pv_derivatives<F>(times, amounts, r);
+  double g = F == Flow::Discrete ? 1 + r : 1;
+  bond_measures<double> m;
+  m.yield = r;
+  m.price = d.pv;
+  m.macaulay_duration = -d.dpv * g / d.pv;
+  m.modified_duration = -d.dpv / d.pv;
+  m.convexity = d.d2pv / d.pv;
+  m.dv01 = -d.dpv * 1.0e-4;
+  return m;
+}
+
+} // namespace sfinx::aux
+
+using aux::pv;
+using aux::pv_derivatives;
+using aux::bond_analytics;
+
+} // namespace sfinx
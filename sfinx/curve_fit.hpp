@@ -0,0 +1,262 @@
+#pragma once
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <vector>
+#include "matrix/eigen.hpp"
+#include "span.hpp"
+#include "thread_pool.hpp"
+#include "term_structure.hpp"
+
+namespace sfinx {
+namespace term_structure {
+
+struct fit_settings
+{
+  size_t max_iterations = 200;
+  double tolerance = 1.0e-10;    // relative step or error reduction of a converged fit
+};
+
+template <typename Params>
+struct fit_result
+{
+  Params params;
+  double rmse;          // root mean square yield residual
+  size_t iterations;    // Levenberg-Marquardt steps, accepted or not
+  bool converged;
+};
+
+namespace aux {
+
+/// (1 - exp(-x)) / x and exp(-x) from one expm1
+inline void decay(double x, double& l, double& e)
+{
+  double em1 = std::expm1(-x);
+  e = 1 + em1;
+  l = x == 0 ? 1 : -em1 / x;
+}
+
+/**
+ * Model rate r(t) at the parameters p and its gradient g in p, betas first and the decay
+ * times last. With (1 - e) / x = l, d l / dx = (e - l) / x, and d x / d lambda = -x / lambda.
+ **/
+struct nelson_siegel_model
+{
+  typedef nelson_siegel_params params;
+  static constexpr int size = 4, decays = 1;
+
+  static std::array<double, size> get(params const& q) { return {{ q.b0, q.b1, q.b2, q.lambda }}; }
+  static params set(double const* p) { return params{ p[0], p[1], p[2], p[3] }; }
+
+  static double rate(double const* p, double t, double* g)
+  {
+    double x = t / p[3], l, e;
+    decay(x, l, e);
+    g[0] = 1;
+    g[1] = l;
+    g[2] = l + e;
+    g[3] = -((p[1] + p[2]) * (e - l) - p[2] * x * e) / p[3];
+    return p[0] + p[1] * g[1] + p[2] * g[2];
+  }
+};
+
+struct svensson_model
+{
+  typedef svensson_params params;
+  static constexpr int size = 6, decays = 2;
+
+  static std::array<double, size> get(params const& q)
+  {
+    return {{ q.b0, q.b1, q.b2, q.b3, q.t1, q.t2 }};
+  }
+  static params set(double const* p) { return params{ p[0], p[1], p[2], p[3], p[4], p[5] }; }
+
+  static double rate(double const* p, double t, double* g)
+  {
+    double x1 = t / p[4], x2 = t / p[5], l1, e1, l2, e2;
+    decay(x1, l1, e1);
+    decay(x2, l2, e2);
+    g[0] = 1;
+    g[1] = l1;
+    g[2] = l1 - e1;
+    g[3] = l2 - e2;
+    g[4] = -(p[1] * (e1 - l1) + p[2] * (e1 - l1 + x1 * e1)) / p[4];
+    g[5] = -p[3] * (e2 - l2 + x2 * e2) / p[5];
+    return p[0] + p[1] * g[1] + p[2] * g[2] + p[3] * g[3];
+  }
+};
+
+/**
+ * Levenberg-Marquardt from start on the yields y at t. The normal equations J'J and J'r are
+ * summed from the analytic gradients in one pass over the points and the damped system
+ * (J'J + mu diag J'J) dp = -J'r is solved by matrix::solve; mu follows Nielsen's update.
+ * Steps that make a decay time non positive are rejected like steps that increase the error.
+ * The fit has converged when the step or both the actual and the predicted relative reduction
+ * of the error are within the tolerance.
+ * The initial mu is tau times the largest diagonal of J'J, small when start is near the fit.
+ **/
+template <typename Model>
+fit_result<typename Model::params> levenberg_marquardt(span<double const> t, span<double const> y,
+                                                       typename Model::params const& start,
+                                                       double tau, fit_settings const& s)
+{
+  int const K = Model::size;
+  typedef decltype(matrix::matrix<double, K, K>()) square;
+  typedef decltype(matrix::matrix<double, K, 1>()) vector;
+  assert(t.size() == y.size() && t.size() >= size_t(K));
+
+  auto normal = [&](vector const& p, square& A, vector& g) {
+    A.setZero();
+    g.setZero();
+    vector f;
+    double sse = 0;
+    for (size_t i = 0; i < t.size(); ++i) {
+      double r = Model::rate(p.data(), t[i], f.data()) - y[i];
+      A.noalias() += f * f.transpose();
+      g.noalias() += f * r;
+      sse += r * r;
+    }
+    return sse;
+  };
+  auto error = [&](vector const& p) {
+    vector f;
+    double sse = 0;
+    for (size_t i = 0; i < t.size(); ++i) {
+      double r = Model::rate(p.data(), t[i], f.data()) - y[i];
+      sse += r * r;
+    }
+    return sse;
+  };
+
+  std::array<double, K> p0 = Model::get(start);
+  vector p = Eigen::Map<vector>(p0.data()), dp, g;
+  square A, D;
+  double sse = normal(p, A, g), mu = tau * A.diagonal().maxCoeff(), nu = 2;
+  fit_result<typename Model::params> res;
+  res.converged = false;
+  for (res.iterations = 0; res.iterations < s.max_iterations && !res.converged;) {
+    ++res.iterations;
+    D = square::Zero();
+    for (int k = 0; k < K; ++k)
+      D(k, k) = std::max(A(k, k), 1.0e-12);
+    dp = matrix::solve(square(A + mu * D), vector(-g));
+    res.converged = dp.norm() <= s.tolerance * (p.norm() + s.tolerance);
+    vector q = p + dp;
+    bool valid = true;
+    for (int k = K - Model::decays; k < K; ++k)
+      valid = valid && q(k) > 0;
+    double trial = valid ? error(q) : HUGE_VAL;
+    double predicted = dp.dot(mu * D * dp - g), rho = (sse - trial) / predicted;
+    res.converged = res.converged ||
+                    (std::abs(sse - trial) <= s.tolerance * sse && predicted <= s.tolerance * sse);
+    if (rho > 0) {
+      p = q;
+      sse = normal(p, A, g);
+      mu *= std::max(1.0 / 3, 1 - std::pow(2 * rho - 1, 3));
+      nu = 2;
+    }
+    else {
+      mu *= nu;
+      nu *= 2;
+    }
+    res.converged = res.converged || sse == 0;
+  }
+  res.params = Model::set(p.data());
+  res.rmse = sqrt(sse / t.size());
+  return res;
+}
+
+/// Start at the decay times of decay with the betas of the linear least squares fit there
+template <typename Model>
+typename Model::params linear_start(span<double const> t, span<double const> y,
+                                    double const* decay)
+{
+  int const K = Model::size, L = K - Model::decays;
+  typedef decltype(matrix::matrix<double, matrix::dynamic, matrix::dynamic>()) dense;
+  typedef decltype(matrix::matrix<double, matrix::dynamic, 1>()) column;
+  std::array<double, K> p = {{}}, g;
+  std::copy(decay, decay + Model::decays, p.begin() + L);
+  dense X(t.size(), L);
+  column b(t.size());
+  for (size_t i = 0; i < t.size(); ++i) {
+    Model::rate(p.data(), t[i], g.data());
+    for (int k = 0; k < L; ++k)
+      X(i, k) = g[k];
+    b(i) = y[i];
+  }
+  column beta = matrix::least_squares(X, b);
+  std::copy(beta.data(), beta.data() + L, p.begin());
+  return Model::set(p.data());
+}
+
+/// Best of the fits from each set of decay times in starts, fitted in parallel
+template <typename Model>
+fit_result<typename Model::params>
+multi_start(span<double const> t, span<double const> y,
+            std::vector<std::array<double, Model::decays>> const& starts,
+            fit_settings const& s, thread_pool& pool)
+{
+  assert(!starts.empty());
+  std::vector<fit_result<typename Model::params>> fits(starts.size());
+  pool.parallel_for(starts.size(), [&](size_t j) {
+    fits[j] = levenberg_marquardt<Model>(t, y, linear_start<Model>(t, y, starts[j].data()), 1.0e-3,
+                                         s);
+  });
+  return *std::min_element(fits.begin(), fits.end(),
+      [](fit_result<typename Model::params> const& a, fit_result<typename Model::params> const& b) {
+        return a.rmse < b.rmse;
+      });
+}
+
+} // namespace sfinx::term_structure::aux
+
+/**
+ * Least squares fit of nelson_siegel to the zero yields y at maturities t, warm started from
+ * a previous fit: an intraday refit to yields that moved a little takes a few iterations.
+ **/
+inline fit_result<nelson_siegel_params>
+fit_nelson_siegel(span<double const> t, span<double const> y, nelson_siegel_params const& start,
+                  fit_settings const& s = fit_settings())
+{
+  return aux::levenberg_marquardt<aux::nelson_siegel_model>(t, y, start, 1.0e-6, s);
+}
+
+/**
+ * Cold fit from each lambda in lambdas, the betas of each start from linear least squares at
+ * its lambda, the starts spread over the pool. The fit of least error is returned.
+ **/
+inline fit_result<nelson_siegel_params>
+fit_nelson_siegel(span<double const> t, span<double const> y, span<double const> lambdas,
+                  thread_pool& pool, fit_settings const& s = fit_settings())
+{
+  std::vector<std::array<double, 1>> starts;
+  for (double l : lambdas)
+    starts.push_back({{ l }});
+  return aux::multi_start<aux::nelson_siegel_model>(t, y, starts, s, pool);
+}
+
+/// Least squares fit of svensson, warm started
+inline fit_result<svensson_params>
+fit_svensson(span<double const> t, span<double const> y, svensson_params const& start,
+             fit_settings const& s = fit_settings())
+{
+  return aux::levenberg_marquardt<aux::svensson_model>(t, y, start, 1.0e-6, s);
+}
+
+/// Cold fit of svensson from every pair t1 < t2 of taus
+inline fit_result<svensson_params>
+fit_svensson(span<double const> t, span<double const> y, span<double const> taus,
+             thread_pool& pool, fit_settings const& s = fit_settings())
+{
+  std::vector<std::array<double, 2>> starts;
+  for (double t1 : taus)
+    for (double t2 : taus)
+      if (t1 < t2)
+        starts.push_back({{ t1, t2 }});
+  return aux::multi_start<aux::svensson_model>(t, y, starts, s, pool);
+}
+
+} // namespace term_structure
+} // namespace sfinx
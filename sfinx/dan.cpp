@@ -1,15 +1,29 @@
 #include <cmath>
 #include <array>
+#include <functional>
 #include <tuple>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
 #include <gtest/gtest.h>
 #include "discount_factor.hpp"
 #include "math.hpp"
 #include "pv.hpp"
 #include "irr.hpp"
 #include "bond.hpp"
+#include "cashflow_book.hpp"
+#include "coupon_schedule.hpp"
+#include "discount_curve.hpp"
+#include "spline.hpp"
+#include "scenario.hpp"
 #include "black_scholes.hpp"
 #include "term_structure.hpp"
 #include "interest_rate.hpp"
+#include "short_rate_paths.hpp"
+#include "simd.hpp"
+#include "random.hpp"
+#include "thread_pool.hpp"
+#include "qmc.hpp"
 
 
 using namespace sfinx;
@@ -27,6 +41,66 @@ TEST(sfinx, linear_interpolate)
   EXPECT_FALSE(linear_interpolate(2.1, xs, ys).second);
 }
 
+TEST(sfinx, cubic_spline)
+{
+  std::vector<double> x = { 0, 0.5, 1.2, 2, 3.5, 5, 7 }, y;
+  for (double xi : x)
+    y.push_back(sin(xi));
+  cubic_spline natural(x, y), monotone(x, y, Spline::Monotone);
+  EXPECT_EQ(natural.size(), x.size());
+  for (size_t i = 0; i < x.size(); ++i) {
+    EXPECT_NEAR(natural(x[i]), y[i], 1.0e-15);
+    EXPECT_NEAR(monotone(x[i]), y[i], 1.0e-15);
+  }
+  EXPECT_NEAR(natural(2.7), sin(2.7), 2.0e-2);
+
+  // C2 inside, zero curvature at the ends, linear outside
+  double h = 1.0e-4;
+  auto d2 = [&](double t) { return (natural(t + h) - 2 * natural(t) + natural(t - h)) / (h * h); };
+  for (size_t i = 1; i + 1 < x.size(); ++i)
+    EXPECT_NEAR(d2(x[i] - 2 * h), d2(x[i] + 2 * h), 1.0e-2);
+  EXPECT_NEAR(d2(x.front() + h), 0.0, 1.0e-2);
+  EXPECT_NEAR(d2(x.back() - h), 0.0, 1.0e-2);
+  EXPECT_NEAR(natural(-1) - natural(-2), natural(-2) - natural(-3), 1.0e-12);
+  EXPECT_NEAR(natural(9) - natural(8), natural(10) - natural(9), 1.0e-12);
+
+  // a line is reproduced by both
+  std::vector<double> line;
+  for (double xi : x)
+    line.push_back(2 - 0.5 * xi);
+  cubic_spline nl(x, line), ml(x, line, Spline::Monotone);
+  EXPECT_NEAR(nl(3.3), 2 - 0.5 * 3.3, 1.0e-14);
+  EXPECT_NEAR(ml(6.1), 2 - 0.5 * 6.1, 1.0e-14);
+
+  // a step: the natural spline overshoots, the monotone one stays in range and monotone
+  std::vector<double> step = { 0, 0, 0, 1, 1, 1, 1 };
+  cubic_spline ns(x, step), ms(x, step, Spline::Monotone);
+  double lo = 1, hi = 0, prev = ms(0);
+  for (double t = 0; t <= 7; t += 0.01) {
+    lo = std::min(lo, ns(t));
+    hi = std::max(hi, ns(t));
+    EXPECT_GE(ms(t), prev);
+    EXPECT_GE(ms(t), 0.0);
+    EXPECT_LE(ms(t), 1.0);
+    prev = ms(t);
+  }
+  EXPECT_LT(lo, -0.01);
+  EXPECT_GT(hi, 1.01);
+
+  // hinted and batch lookups agree with the single ones
+  std::vector<double> q;
+  for (double t = -1; t < 8; t += 0.037)
+    q.push_back(t);
+  std::vector<double> out(q.size());
+  monotone(q, out);
+  size_t hint = 0, back = 0;
+  for (size_t i = 0; i < q.size(); ++i) {
+    EXPECT_DOUBLE_EQ(out[i], monotone(q[i]));
+    EXPECT_EQ(monotone(q[i], hint), monotone(q[i]));
+    EXPECT_EQ(natural(q[q.size() - 1 - i], back), natural(q[q.size() - 1 - i]));
+  }
+}
+
 TEST(sfinx, erfc)
 {
   double eps = 1.0e-15;
@@ -53,6 +127,164 @@ TEST(sfinx, normal_cdf)
   EXPECT_LT(fabs(normal_cdf(2) - 0.9772), eps);
 }
 
+TEST(sfinx, bivariate_normal_cdf)
+{
+  double eps = 1.0e-15;
+  for (double rho : { -0.99, -0.8, -0.5, 0.0, 0.2, 0.5, 0.8, 0.95, 0.99 })
+    EXPECT_NEAR(bivariate_normal_cdf(0, 0, rho), 0.25 + asin(rho) / (2 * Pi), eps);
+  for (double a : { -2.0, -0.3, 0.0, 1.5 })
+    for (double b : { -1.0, 0.4, 2.5 }) {
+      EXPECT_NEAR(bivariate_normal_cdf(a, b, 0), normal_cdf(a) * normal_cdf(b), eps);
+      EXPECT_NEAR(bivariate_normal_cdf(a, b, 1), normal_cdf(std::min(a, b)), eps);
+      EXPECT_NEAR(bivariate_normal_cdf(a, b, -1),
+                  std::max(0.0, normal_cdf(a) + normal_cdf(b) - 1), eps);
+      // Symmetry M(a, b, rho) + M(a, -b, -rho) = N(a)
+      EXPECT_NEAR(bivariate_normal_cdf(a, b, 0.6) + bivariate_normal_cdf(a, -b, -0.6),
+                  normal_cdf(a), eps);
+      EXPECT_NEAR(bivariate_normal_cdf(a, b, 0.97) + bivariate_normal_cdf(a, -b, -0.97),
+                  normal_cdf(a), eps);
+    }
+}
+
+TEST(sfinx, normal_tiers)
+{
+  using namespace sfinx::normal;
+  for (double x = -9; x <= 9; x += 0.0625) {
+    double e = exact_cdf(x);
+    EXPECT_NEAR(rational_cdf(x), e, 1.0e-10 * e);
+    EXPECT_NEAR(fast_cdf(x), e, 7.5e-8);
+    EXPECT_NEAR(exact_cdf(float(x)), e, 1.0e-6);
+    EXPECT_NEAR(fast_cdf(float(x)), e, 1.0e-6);
+    EXPECT_NEAR(exact_pdf(x), 0.3989422804014327 * exp(-x * x / 2), 1.0e-16);
+    double c[simd::pack::size], f[simd::pack::size];
+    simd::rational_cdf(x).store(c);
+    simd::fast_cdf(x).store(f);
+    EXPECT_NEAR(c[0], e, 1.0e-13 * e);
+    EXPECT_NEAR(f[0], fast_cdf(x), 1.0e-15);
+  }
+}
+
+TEST(sfinx, philox)
+{
+  // known answers of Random123
+  random::philox a(0, 0, 0, 0, 0);
+  EXPECT_EQ(a.c[0], 0x6627e8d5u);
+  EXPECT_EQ(a.c[3], 0x9b00dbd8u);
+  random::philox b(0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344, 0x299f31d0a4093822ull);
+  EXPECT_EQ(b.c[0], 0xd16cfe09u);
+  EXPECT_EQ(b.c[1], 0x94fdccebu);
+  EXPECT_EQ(b.c[2], 0x5001e420u);
+  EXPECT_EQ(b.c[3], 0x24126ea1u);
+
+  size_t n = 1 << 16;
+  std::vector<double> z(n);
+  random::normals(7, 0, 3, z.data(), n);
+  double m1 = 0, m2 = 0, m4 = 0;
+  for (double x : z) {
+    m1 += x / n;
+    m2 += x * x / n;
+    m4 += x * x * x * x / n;
+  }
+  EXPECT_NEAR(m1, 0, 0.02);
+  EXPECT_NEAR(m2, 1, 0.02);
+  EXPECT_NEAR(m4, 3, 0.1);
+
+  // any slice of the stream can be drawn on its own
+  double part[32];
+  random::normals(7, 4096, 3, part, 32);
+  for (size_t i = 0; i < 32; ++i)
+    EXPECT_EQ(part[i], z[4096 + i]);
+}
+
+TEST(sfinx, thread_pool)
+{
+  thread_pool pool(4);
+  EXPECT_EQ(pool.size(), 4u);
+  for (size_t n : { 0, 1, 3, 1000 }) {
+    std::vector<int> hits(n);
+    pool.parallel_for(n, [&](size_t i) { ++hits[i]; });
+    EXPECT_EQ(std::count(hits.begin(), hits.end(), 1), std::ptrdiff_t(n));
+  }
+  EXPECT_THROW(pool.parallel_for(10, [](size_t i) { if (i == 7) throw std::runtime_error("7"); }),
+               std::runtime_error);
+}
+
+TEST(sfinx, inverse_normal_cdf)
+{
+  for (double p : { 1.0e-300, 1.0e-20, 1.0e-5, 0.02, 0.3, 0.5, 0.574, 0.9, 0.99999 }) {
+    double x = inverse_normal_cdf(p);
+    EXPECT_NEAR(normal_cdf(x), p, 1.0e-13 * std::min(p, 1 - p));
+    if (p >= 1.0e-5) {
+      EXPECT_NEAR(inverse_normal_cdf(1 - p), -x, 1.0e-9 * std::fabs(x));
+    }
+  }
+  double ps[] = { 1.0e-12, 0.01, 0.2, 0.45, 0.5, 0.7, 0.97, 1 - 1.0e-9 };
+  for (size_t i = 0; i < 8; i += simd::pack::size) {
+    double z[8];
+    simd::inverse_normal_cdf(simd::pack::load(ps + i)).store(z + i);
+    for (size_t k = i; k < i + simd::pack::size; ++k)
+      EXPECT_NEAR(z[k], inverse_normal_cdf(ps[k]), 1.0e-14 * (1 + std::fabs(z[k])));
+  }
+}
+
+TEST(sfinx, sobol)
+{
+  double const d0[] = { 0, 0.5, 0.75, 0.25, 0.375, 0.875, 0.625, 0.125 };
+  double const d2[] = { 0, 0.5, 0.25, 0.75, 0.625, 0.125, 0.875, 0.375 };
+  double const half = 0.5 / 4294967296.0;
+  qmc::sobol plain(1024);
+  std::vector<double> x(1024 * 8);
+  plain.points(0, 8, x.data());
+  for (size_t i = 0; i < 8; ++i) {
+    EXPECT_EQ(x[i], d0[i] + half);
+    EXPECT_EQ(x[2 * 8 + i], d2[i] + half);
+  }
+
+  // skip ahead to any point
+  std::vector<double> tail(1024 * 3);
+  plain.points(5, 3, tail.data());
+  for (size_t k = 0; k < 1024; ++k)
+    for (size_t i = 0; i < 3; ++i)
+      EXPECT_EQ(tail[k * 3 + i], x[k * 8 + 5 + i]);
+
+  // scrambled, 2^m points still put one point in every interval of width 2^-m
+  size_t n = 256, d = 64;
+  qmc::sobol scrambled(d, true, 11);
+  std::vector<double> u(d * n);
+  scrambled.points(0, n, u.data());
+  for (size_t k = 0; k < d; ++k) {
+    std::vector<int> hits(n);
+    for (size_t i = 0; i < n; ++i)
+      ++hits[size_t(u[k * n + i] * n)];
+    EXPECT_EQ(std::count(hits.begin(), hits.end(), 1), std::ptrdiff_t(n));
+  }
+  EXPECT_NE(u[0], x[0]);
+}
+
+TEST(sfinx, brownian_bridge)
+{
+  // the bridge is linear, its columns A satisfy A A' = min(t_i, t_j)
+  std::vector<double> t = { 0.1, 0.25, 0.3, 0.7, 1.0, 1.6, 2.0 };
+  size_t n = t.size(), m = 8;
+  qmc::brownian_bridge bridge(t);
+  std::vector<double> A(n * n), z(n * m), w(n * m);
+  for (size_t c = 0; c < n; ++c) {
+    std::fill(z.begin(), z.end(), 0.0);
+    std::fill(z.begin() + c * m, z.begin() + (c + 1) * m, 1.0);
+    bridge.transform(z.data(), w.data(), m);
+    for (size_t r = 0; r < n; ++r)
+      A[r * n + c] = w[r * m + m - 1];
+  }
+  for (size_t i = 0; i < n; ++i)
+    for (size_t j = 0; j < n; ++j) {
+      double s = 0;
+      for (size_t k = 0; k < n; ++k)
+        s += A[i * n + k] * A[j * n + k];
+      EXPECT_NEAR(s, std::min(t[i], t[j]), 1.0e-14);
+    }
+  EXPECT_NEAR(A[(n - 1) * n], sqrt(t[n - 1]), 1.0e-15);
+}
+
 TEST(sfinx, discount_factor)
 {
   double eps = 1.0e-6;
@@ -83,6 +315,21 @@ TEST(sfinx, irr)
   double times[] = { 0, 1.0, 2.0 };
   double amounts[] = { -100.0, 10.0, 110.0 };
   EXPECT_LT(fabs(irr<Flow::Discrete>(times, amounts) - 0.1), eps);
+
+  // to full precision in a few walks over the flows, negative and large rates included
+  solver::trace t;
+  EXPECT_NEAR(irr<Flow::Discrete>(times, amounts, &t), 0.1, 1.0e-12);
+  EXPECT_LE(t.evaluations, 5u);
+  double loss[] = { -100.0, 1.0, 97.0 };
+  double r = irr<Flow::Discrete>(times, loss, &t);
+  EXPECT_LT(r, 0.0);
+  EXPECT_NEAR(pv<Flow::Discrete>(times, loss, r), 0.0, 1.0e-10);
+  EXPECT_LE(t.evaluations, 6u);
+  double gain[] = { -100.0, 0.0, 900.0 };
+  EXPECT_NEAR(irr<Flow::Discrete>(times, gain), 2.0, 1.0e-12);
+  EXPECT_NEAR(irr<Flow::Continuous>(times, gain), log(3.0), 1.0e-12);
+  double none[] = { 100.0, 10.0, 110.0 };
+  EXPECT_TRUE(std::isnan(irr<Flow::Discrete>(times, none)));
 }
 
 TEST(sfinx, bond_price)
@@ -100,6 +347,16 @@ TEST(sfinx, ytm)
   double times[] = { 1.0, 2.0, 3.0 };
   double amounts[] = { 10.0, 10.0, 110.0 };
   EXPECT_LT(fabs(ytm<Flow::Discrete>(times, amounts, 102.531) - 0.09), eps);
+
+  solver::trace t;
+  double price = bond_price<Flow::Discrete>(times, amounts, 0.09);
+  EXPECT_NEAR(ytm<Flow::Discrete>(times, amounts, price, &t), 0.09, 1.0e-12);
+  EXPECT_LE(t.evaluations, 4u);
+  price = bond_price<Flow::Continuous>(times, amounts, -0.01);
+  EXPECT_NEAR(ytm<Flow::Continuous>(times, amounts, price, &t), -0.01, 1.0e-12);
+  EXPECT_LE(t.evaluations, 4u);
+  price = bond_price<Flow::Discrete>(times, amounts, 1.5);
+  EXPECT_NEAR(ytm<Flow::Discrete>(times, amounts, price, &t), 1.5, 1.0e-12);
 }
 
 TEST(sfinx, bond_duration)
@@ -136,6 +393,277 @@ TEST(sfinx, bond_convexity)
   EXPECT_LT(fabs(bond_convexity<Flow::Continuous>(times, amounts, 0.09) - 7.86779), eps);
 }
 
+TEST(sfinx, bond_analytics)
+{
+  double eps = 1.0e-5;
+  double times[] = { 1.0, 2.0, 3.0 };
+  double amounts[] = { 10.0, 10.0, 110.0 };
+  auto d = bond_analytics<Flow::Discrete>(times, amounts, 0.09);
+  EXPECT_LT(fabs(d.price - 102.531), 1.0e-3);
+  EXPECT_LT(fabs(d.macaulay_duration - 2.73895), eps);
+  EXPECT_LT(fabs(d.modified_duration - 2.73895 / 1.09), eps);
+  EXPECT_LT(fabs(d.convexity - 8.93248), eps);
+  double up = bond_price<Flow::Discrete>(times, amounts, 0.0901);
+  double down = bond_price<Flow::Discrete>(times, amounts, 0.0899);
+  EXPECT_LT(fabs(d.dv01 - (down - up) / 2), 1.0e-8);
+
+  auto c = bond_analytics<Flow::Continuous>(times, amounts, 0.09);
+  EXPECT_LT(fabs(c.price - 101.464), 1.0e-3);
+  EXPECT_LT(fabs(c.macaulay_duration - 2.73753), eps);
+  EXPECT_EQ(c.modified_duration, c.macaulay_duration);
+  EXPECT_LT(fabs(c.convexity - 7.86779), eps);
+
+  auto p = bond_analytics_at_price<Flow::Discrete>(times, amounts, 102.531);
+  EXPECT_LT(fabs(p.yield - 0.09), 1.0e-4);
+  EXPECT_LT(fabs(p.macaulay_duration - 2.73895), eps);
+  EXPECT_LT(fabs(p.modified_duration - 2.5128), 1.0e-4);
+}
+
+TEST(sfinx, cashflow_book)
+{
+  // semiannual bonds of 1 to 30 years, coupons 1% to 8%
+  aligned_cashflow_book book;
+  std::vector<double> yield, price;
+  for (int k = 0; k < 3000; ++k) {
+    std::vector<double> times, amounts;
+    int n = 2 * (1 + k % 30);
+    double c = 1 + k % 8;
+    for (int i = 1; i <= n; ++i) {
+      times.push_back(i / 2.0);
+      amounts.push_back(c / 2 + (i == n ? 100 : 0));
+    }
+    EXPECT_EQ(book.add(times, amounts), size_t(k));
+    yield.push_back(0.001 * (k % 97) - 0.01);
+  }
+  EXPECT_EQ(book.size(), 3000u);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(book.times().data()) % 64, 0u);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(book.amounts().data()) % 64, 0u);
+
+  size_t n = book.size();
+  std::vector<double> p(n), mac(n), mod(n), cx(n), dv(n), y(n), p2(n);
+  bond_measures<span<double>> out;
+  out.price = p;
+  out.macaulay_duration = mac;
+  out.modified_duration = mod;
+  out.convexity = cx;
+  out.dv01 = dv;
+  thread_pool pool(3);
+  bond_analytics<Flow::Discrete>(book, yield, out, pool);
+  for (size_t k = 0; k < n; k += 7) {
+    auto m = bond_analytics<Flow::Discrete>(book.times(k), book.amounts(k), yield[k]);
+    EXPECT_EQ(p[k], m.price);
+    EXPECT_EQ(mac[k], m.macaulay_duration);
+    EXPECT_EQ(cx[k], m.convexity);
+    EXPECT_EQ(dv[k], m.dv01);
+  }
+
+  // back to the yields from the prices, price column left out
+  bond_measures<span<double>> at;
+  at.yield = y;
+  at.modified_duration = p2;
+  bond_analytics_at_price<Flow::Discrete>(book, p, at, pool);
+  for (size_t k = 0; k < n; ++k) {
+    EXPECT_NEAR(y[k], yield[k], 1e-11);
+    EXPECT_NEAR(p2[k], mod[k], 1e-9);
+  }
+
+  // one curve for all: continuous flat 3%, the table has the 60 distinct payment dates
+  discount_table table(book);
+  EXPECT_EQ(table.times().size(), 60u);
+  auto df = table.discount([](double t) { return discount_factor(0.03, t); });
+  bond_price(book, table, df, p2, pool);
+  for (size_t k = 0; k < n; ++k)
+    EXPECT_NEAR(p2[k], pv<Flow::Continuous>(book.times(k), book.amounts(k), 0.03), 1e-10);
+}
+
+TEST(sfinx, coupon_schedule)
+{
+  // 30 year semiannual 5% and a 2.3 year quarterly 4% with a short first period
+  coupon_schedule a(100, 0.05, 2, 30), b(1000, 0.04, 4, 2.3);
+  EXPECT_EQ(a.size(), 60u);
+  EXPECT_EQ(b.size(), 10u);
+  EXPECT_NEAR(b.first(), 0.05, 1e-15);
+  for (auto const* s : { &a, &b }) {
+    std::vector<double> times(s->times().begin(), s->times().end());
+    std::vector<double> amounts(s->amounts().begin(), s->amounts().end());
+    EXPECT_EQ(times.back(), s->maturity());
+    for (double r : { -0.02, 0.0, 1e-9, 0.03, 0.5 }) {
+      double p = pv<Flow::Discrete>(times, amounts, r);
+      EXPECT_NEAR(pv<Flow::Discrete>(s->times(), s->amounts(), r), p, 1e-12 * p);
+      EXPECT_NEAR(pv<Flow::Continuous>(s->times(), s->amounts(), r),
+                  pv<Flow::Continuous>(times, amounts, r), 1e-12 * p);
+      auto m = bond_analytics<Flow::Discrete>(s->times(), s->amounts(), r);
+      auto g = bond_analytics<Flow::Discrete>(times, amounts, r);
+      EXPECT_NEAR(m.price, g.price, 1e-12 * p);
+      EXPECT_NEAR(m.macaulay_duration, g.macaulay_duration, 1e-12 * g.macaulay_duration);
+      EXPECT_NEAR(m.modified_duration, g.modified_duration, 1e-12 * g.modified_duration);
+      EXPECT_NEAR(m.convexity, g.convexity, 1e-12 * g.convexity);
+      EXPECT_NEAR(m.dv01, g.dv01, 1e-12 * g.dv01);
+      EXPECT_NEAR(bond_convexity<Flow::Continuous>(s->times(), s->amounts(), r),
+                  bond_convexity<Flow::Continuous>(times, amounts, r), 1e-10);
+      EXPECT_NEAR(ytm<Flow::Discrete>(s->times(), s->amounts(), p), r, 1e-11);
+    }
+  }
+
+  // the generic bond functions return exactly what the schedule overloads do
+  double r = 0.037, P = aux::pv<Flow::Discrete>(a.times(), a.amounts(), r);
+  EXPECT_EQ(bond_price<Flow::Discrete>(a.times(), a.amounts(), r), P);
+  auto fast = aux::bond_analytics<Flow::Discrete>(a.times(), a.amounts(), r);
+  EXPECT_EQ(bond_duration<Flow::Discrete>(a.times(), a.amounts(), r), fast.macaulay_duration);
+  EXPECT_EQ(bond_convexity<Flow::Discrete>(a.times(), a.amounts(), r), fast.convexity);
+  auto f = [&](double y) {
+    auto d = aux::pv_derivatives<Flow::Discrete>(a.times(), a.amounts(), y);
+    return std::make_tuple(d.pv - 97, d.dpv, d.d2pv);
+  };
+  double y = solver::halley(f, aux::yield_guess<Flow::Discrete>(a.times(), a.amounts(), 97.0),
+                            std::make_pair(-1.0, HUGE_VAL), 1.0e-12).first;
+  EXPECT_EQ(ytm<Flow::Discrete>(a.times(), a.amounts(), 97), y);
+
+  // the lazy ranges fill a cashflow book like any container
+  cashflow_book book;
+  book.add(a.times(), a.amounts());
+  EXPECT_EQ(book.flows(), 60u);
+  EXPECT_EQ(book.amounts(0)[59], 102.5);
+}
+
+TEST(sfinx, discount_curve)
+{
+  std::vector<instrument> market = {
+    instrument::deposit(0.25, 0.030), instrument::deposit(0.5, 0.032),
+    instrument::future(0.5, 0.75, 96.60), instrument::future(0.75, 1.0, 96.50),
+    instrument::swap(2, 0.036, 2), instrument::swap(3, 0.038, 2),
+    instrument::swap(5, 0.040, 2), instrument::swap(10, 0.042, 2)
+  };
+  std::vector<double> bt = { 3, 6, 9, 12 }, bc = { 2.5, 2.5, 2.5, 102.5 };
+  market.push_back(instrument::bond(bt, bc, 66.0));
+
+  Interpolation schemes[] = { Interpolation::LinearZero, Interpolation::LogLinearDiscount,
+                              Interpolation::MonotoneCubic };
+  std::vector<double> grid;
+  for (double t = 0; t < 15; t += 0.01)
+    grid.push_back(t);
+  for (Interpolation s : schemes) {
+    discount_curve c = bootstrap(market, s);
+    EXPECT_EQ(c.size(), market.size());
+    for (instrument const& m : market)
+      EXPECT_NEAR(m.error(c), 0.0, 1.0e-12);
+
+    std::vector<double> out(grid.size());
+    c.df(grid, out);
+    size_t hint = 0, back = c.size();
+    for (size_t i = 0; i < grid.size(); ++i) {
+      EXPECT_EQ(out[i], c.df(grid[i]));
+      EXPECT_EQ(c.df(grid[grid.size() - 1 - i], back), c.df(grid[grid.size() - 1 - i]));
+      if (i > 0) {
+        EXPECT_LT(out[i], out[i - 1]);    // positive forwards
+      }
+    }
+    EXPECT_EQ(c.df(7.3, hint), c.df(7.3));
+    EXPECT_EQ(c.df(0.1, hint), c.df(0.1));
+    EXPECT_NEAR(c.df(0.0), 1.0, 1.0e-15);
+    EXPECT_NEAR(c.zero(0.5), -log(c.df(0.5)) / 0.5, 1.0e-15);
+    EXPECT_NEAR(c.forward(1, 2), -log(c.df(2) / c.df(1)), 1.0e-15);
+  }
+
+  // the schemes agree at the pillars of a curve they all interpolate
+  std::vector<double> t = { 0.5, 1, 2, 5, 10 }, df;
+  for (double ti : t)
+    df.push_back(exp(-(0.02 + 0.002 * ti) * ti));
+  discount_curve linear(t, df, Interpolation::LinearZero);
+  discount_curve loglinear(t, df, Interpolation::LogLinearDiscount);
+  discount_curve cubic(t, df, Interpolation::MonotoneCubic);
+  for (size_t i = 0; i < t.size(); ++i) {
+    EXPECT_NEAR(linear.df(t[i]), df[i], 1.0e-15);
+    EXPECT_NEAR(loglinear.df(t[i]), df[i], 1.0e-15);
+    EXPECT_NEAR(cubic.df(t[i]), df[i], 1.0e-15);
+  }
+  EXPECT_NEAR(linear.zero(12), linear.zero(10), 1.0e-15);
+  EXPECT_NEAR(loglinear.forward(11, 12), loglinear.forward(9, 10), 1.0e-12);
+
+  // pv on a flat curve is the pv at the flat rate
+  double r = 0.045;
+  std::vector<double> flat_df;
+  for (double ti : t)
+    flat_df.push_back(exp(-r * ti));
+  discount_curve flat(t, flat_df);
+  EXPECT_NEAR(pv<Flow::Continuous>(bt, bc, flat), pv<Flow::Continuous>(bt, bc, r), 1.0e-12);
+  EXPECT_NEAR(bond_price<Flow::Continuous>(bt, bc, flat), pv<Flow::Continuous>(bt, bc, r), 1.0e-12);
+
+  // a quote beyond any zero rate Brent brackets leaves its pillar and the later ones unknown
+  std::vector<instrument> broken = { instrument::deposit(1, 0.03), instrument::deposit(2, 50.0),
+                                     instrument::swap(5, 0.04, 2) };
+  for (Interpolation s : schemes) {
+    discount_curve c = bootstrap(broken, s);
+    EXPECT_TRUE(std::isnan(c.df(2)));
+    EXPECT_TRUE(std::isnan(c.df(5)));
+  }
+}
+
+TEST(sfinx, scenario)
+{
+  using namespace sfinx::term_structure;
+  using scenario::overlay;
+  nelson_siegel_curve ns = { { 0.04, -0.015, 0.01, 2.0 } };
+
+  // a parallel shift of the zero rates is a shift of b0
+  overlay up = overlay::parallel(0.001);
+  nelson_siegel_curve ns_up = { { 0.041, -0.015, 0.01, 2.0 } };
+  auto shifted = scenario::apply(ns, up);
+  for (double t : { 0.5, 2.0, 10.0 }) {
+    EXPECT_NEAR(shifted.df(t), ns_up.df(t), 1.0e-15);
+    EXPECT_NEAR(shifted.zero(t), ns_up.zero(t), 1.0e-15);
+  }
+
+  // twist around 5y on a pillar curve, key rate bump local to its hat
+  std::vector<double> pt = { 1, 2, 5, 10, 30 }, pdf;
+  for (double t : pt)
+    pdf.push_back(ns.df(t));
+  discount_curve curve(pt, pdf);
+  overlay steep = overlay::steepener(1.0e-4, 5);
+  overlay key = overlay::key(2, 5, 10, 0.0025);
+  for (double t : { 1.0, 3.0, 5.0, 7.5, 20.0 }) {
+    EXPECT_NEAR(scenario::apply(curve, steep).zero(t) - curve.zero(t), 1.0e-4 * (t - 5), 1.0e-15);
+    double w = t <= 2 || t >= 10 ? 0 : t < 5 ? (t - 2) / 3 : (10 - t) / 5;
+    EXPECT_NEAR(scenario::apply(curve, key).zero(t) - curve.zero(t), 0.0025 * w, 1.0e-15);
+  }
+  EXPECT_EQ(scenario::apply(curve, key).df(1.5), curve.df(1.5));
+  EXPECT_NEAR(scenario::apply(curve, steep).zero(0), curve.zero(0) + steep(0), 1.0e-15);
+  EXPECT_NEAR(scenario::apply(curve, up).zero(0), scenario::apply(curve, up).zero(1.0e-9), 1.0e-8);
+  EXPECT_EQ(scenario::key_rate({ 30, 30, 40, 1.0 })(10), 1.0);    // flat below the first key
+
+  // the book under each scenario against each instrument on its own scenario curve
+  cashflow_book book;
+  for (int k = 0; k < 40; ++k) {
+    coupon_schedule s(100, 0.02 + 0.001 * k, 2, 0.75 + 0.5 * k);
+    book.add(s.times(), s.amounts());
+  }
+  std::vector<overlay> scenarios = { overlay::parallel(0.0), up, steep, key,
+                                     overlay{ 0.0005, -2.0e-5, 10, { { 1, 3, 7, -0.001 } } } };
+  std::vector<double> price(scenarios.size() * book.size());
+  thread_pool pool(2);
+  scenario::reprice(book, ns, scenarios, price, pool);
+  for (size_t s = 0; s < scenarios.size(); ++s) {
+    auto c = scenario::apply(ns, scenarios[s]);
+    for (size_t k = 0; k < book.size(); ++k) {
+      double p = 0;
+      for (size_t j = 0; j < book.times(k).size(); ++j)
+        p += book.amounts(k)[j] * c.df(book.times(k)[j]);
+      EXPECT_NEAR(price[s * book.size() + k], p, 1.0e-12);
+    }
+  }
+
+  // a table built once serves repeated runs, more scenarios than workers share their buffers
+  discount_table table(book);
+  thread_pool three(3);
+  std::vector<double> again(price.size());
+  scenario::reprice(book, table, ns, scenarios, again, three);
+  EXPECT_EQ(again, price);
+  std::vector<overlay> one = { up };
+  scenario::reprice(book, table, ns, one, span<double>(again.data(), book.size()), three);
+  for (size_t k = 0; k < book.size(); ++k)
+    EXPECT_EQ(again[k], price[book.size() + k]);
+}
+
 TEST(sfinx, nelson_siegel)
 {
   using namespace sfinx::term_structure;
@@ -144,6 +672,55 @@ TEST(sfinx, nelson_siegel)
   EXPECT_LT(fabs(nelson_siegel(t, b0, b1, b2, lambda) - 0.0363142), eps);
 }
 
+TEST(sfinx, nelson_siegel_batch)
+{
+  using namespace sfinx::term_structure;
+  std::vector<double> t;
+  for (size_t i = 0; i < 123; ++i)
+    t.push_back(0.25 * i);
+  std::vector<nelson_siegel_params> ns = { { 0.04, -0.02, 0.01, 2.0 }, { 0.05, 0.01, -0.03, 0.7 },
+                                           { 0.03, 0.00, 0.02, 5.0 } };
+  std::vector<svensson_params> sv = { { 0.04, -0.02, 0.01, -0.01, 2.0, 8.0 },
+                                      { 0.05, 0.01, -0.03, 0.02, 0.7, 3.0 } };
+  size_t m = t.size();
+  std::vector<double> zero(ns.size() * m), df(ns.size() * m), forward(ns.size() * m);
+  thread_pool pool(2);
+  nelson_siegel(t, ns, curve_values<span<double>>{ zero, df, forward }, pool);
+
+  auto d = [](double t, std::function<double(double)> const& r) {
+    double h = 1.0e-5;
+    return ((t + h) * r(t + h) - (t - h) * r(t - h)) / (2 * h);
+  };
+  for (size_t k = 0; k < ns.size(); ++k) {
+    nelson_siegel_params const& p = ns[k];
+    auto r = [&](double t) { return nelson_siegel(t, p.b0, p.b1, p.b2, p.lambda); };
+    for (size_t i = 0; i < m; ++i) {
+      EXPECT_NEAR(zero[k * m + i], r(t[i]), 1.0e-15);
+      EXPECT_NEAR(df[k * m + i], exp(-r(t[i]) * t[i]), 1.0e-15);
+      if (i > 0) {
+        EXPECT_NEAR(forward[k * m + i], d(t[i], r), 1.0e-8);
+      }
+    }
+    EXPECT_NEAR(zero[k * m], forward[k * m], 1.0e-15);    // short rate
+  }
+
+  // only the forwards asked for
+  std::vector<double> sforward(sv.size() * m), szero(sv.size() * m);
+  svensson(t, sv, curve_values<span<double>>{ span<double>(), span<double>(), sforward });
+  svensson(t, sv, curve_values<span<double>>{ szero, span<double>(), span<double>() });
+  for (size_t k = 0; k < sv.size(); ++k) {
+    svensson_params const& p = sv[k];
+    auto r = [&](double t) { return svensson(t, p.b0, p.b1, p.b2, p.b3, p.t1, p.t2); };
+    for (size_t i = 0; i < m; ++i) {
+      EXPECT_NEAR(szero[k * m + i], r(t[i]), 1.0e-15);
+      if (i > 0) {
+        EXPECT_NEAR(sforward[k * m + i], d(t[i], r), 1.0e-8);
+      }
+    }
+    EXPECT_NEAR(szero[k * m], sforward[k * m], 1.0e-15);    // short rate
+  }
+}
+
 TEST(sfinx, vasicek)
 {
   using namespace sfinx::interest_rate;
@@ -152,3 +729,206 @@ TEST(sfinx, vasicek)
   EXPECT_LT(fabs(vasicek(t, r0, a, b, sigma) - 0.955408), eps);
 }
 
+TEST(sfinx, short_rate)
+{
+  using namespace sfinx::interest_rate;
+  double r0 = 0.03, a = 0.15, b = 0.05, sigma = 0.02;
+
+  // without mean reversion ln P = -r0 t + sigma^2 t^3 / 6, the limit of small a
+  EXPECT_NEAR(vasicek(10.0, r0, 0.0, b, sigma), exp(-r0 * 10 + sigma * sigma * 1000 / 6), 1.0e-15);
+  EXPECT_NEAR(vasicek(10.0, r0, 0.0, b, sigma), vasicek(10.0, r0, 1.0e-4, b, sigma), 1.0e-3);
+
+  // CIR: the deterministic path as sigma vanishes, the long forward 2ab / (a + h)
+  double T = 7, det = b * T + (r0 - b) * (1 - exp(-a * T)) / a;
+  EXPECT_NEAR(cox_ingersoll_ross(T, r0, a, b, 1.0e-4), exp(-det), 1.0e-6);
+  double s = 0.1, h = sqrt(a * a + 2 * s * s);
+  EXPECT_NEAR(log(cox_ingersoll_ross(200.0, r0, a, b, s) / cox_ingersoll_ross(300.0, r0, a, b, s)) / 100,
+              2 * a * b / (a + h), 1.0e-12);
+
+  // batch prices against the scalar ones
+  std::vector<double> grid;
+  for (double t = 0; t <= 30; t += 0.25)
+    grid.push_back(t);
+  std::vector<short_rate_params> p = { { r0, a, b, sigma }, { 0.01, 0.0, 0.04, 0.01 },
+                                       { 0.05, 0.5, 0.03, 0.08 } };
+  size_t m = grid.size();
+  std::vector<double> vas(p.size() * m), cir(p.size() * m);
+  thread_pool pool(2);
+  vasicek(grid, p, vas, pool);
+  cox_ingersoll_ross(grid, p, cir);
+  for (size_t k = 0; k < p.size(); ++k)
+    for (size_t i = 0; i < m; ++i) {
+      EXPECT_NEAR(vas[k * m + i], vasicek(grid[i], p[k].r0, p[k].a, p[k].b, p[k].sigma), 1.0e-14);
+      if (p[k].a > 0) {
+        double c = cox_ingersoll_ross(grid[i], p[k].r0, p[k].a, p[k].b, p[k].sigma);
+        EXPECT_NEAR(cir[k * m + i], c, 1.0e-13 * c);
+      }
+    }
+
+  // Hull-White reprices its curve at 0 from the short rate f(0, 0)
+  term_structure::nelson_siegel_curve curve = { { 0.04, -0.015, 0.01, 2.0 } };
+  double f0 = curve.zero(0);
+  for (double t : { 0.5, 5.0, 20.0 })
+    EXPECT_NEAR(hull_white(curve, 0.0, t, f0, a, sigma), curve.df(t), 1.0e-9);
+  std::vector<hull_white_params> hw = { { a, sigma }, { 0.0, 0.01 } };
+  std::vector<double> later(grid.begin() + 8, grid.end()), hwp(hw.size() * later.size());
+  hull_white(curve, 2.0, 0.035, later, hw, hwp, pool);
+  for (size_t k = 0; k < hw.size(); ++k)
+    for (size_t i = 0; i < later.size(); ++i)
+      EXPECT_NEAR(hwp[k * later.size() + i],
+                  hull_white(curve, 2.0, later[i], 0.035, hw[k].a, hw[k].sigma), 1.0e-14);
+
+  // bond options: parity, intrinsic value without volatility, and cap - floor = payer swap
+  double PT = vasicek(1.0, r0, a, b, sigma), PS = vasicek(3.0, r0, a, b, sigma), X = 0.93;
+  double call = bond_call(PT, PS, X, 1, 3, a, sigma), put = bond_put(PT, PS, X, 1, 3, a, sigma);
+  EXPECT_NEAR(call - put, PS - X * PT, 1.0e-15);
+  EXPECT_GT(call, std::max(PS - X * PT, 0.0));
+  EXPECT_NEAR(bond_call(PT, PS, X, 1, 3, a, 1.0e-9), std::max(PS - X * PT, 0.0), 1.0e-12);
+  EXPECT_NEAR(bond_call(PT, PS, X, 1, 3, 0.0, sigma), bond_call(PT, PS, X, 1, 3, 1.0e-7, sigma),
+              1.0e-8);
+  std::vector<double> times = { 0.5, 1, 1.5, 2, 2.5, 3 }, df;
+  for (double t : times)
+    df.push_back(curve.df(t));
+  double K = 0.035, swap = 0;
+  for (size_t i = 0; i + 1 < times.size(); ++i)
+    swap += df[i] - df[i + 1] * (1 + K * (times[i + 1] - times[i]));
+  EXPECT_NEAR(cap(times, df, K, a, sigma) - floor(times, df, K, a, sigma), swap, 1.0e-15);
+  EXPECT_GT(cap(times, df, K, a, 2 * sigma), cap(times, df, K, a, sigma));
+}
+
+
+namespace {
+
+/// Per block sums of the short rate at the last date and of the trapezoid discount factor
+struct path_sums
+{
+  double r, rr, df, dfdf;
+};
+
+template <typename Process>
+std::vector<path_sums> simulate_sums(Process const& process,
+                                     sfinx::interest_rate::path_settings const& s,
+                                     thread_pool& pool)
+{
+  std::vector<path_sums> blocks((s.paths + 255) / 256);
+  sfinx::interest_rate::simulate(process, s, [&](sfinx::interest_rate::path_block const& b) {
+    path_sums t = { 0, 0, 0, 0 };
+    for (size_t i = 0; i < b.size; ++i) {
+      double rT = b.rates(b.steps)[i], y = (b.rates(0)[i] + rT) / 2;
+      for (size_t k = 1; k < b.steps; ++k)
+        y += b.rates(k)[i];
+      double df = exp(-y * b.dt);
+      t.r += rT;
+      t.rr += rT * rT;
+      t.df += df;
+      t.dfdf += df * df;
+    }
+    blocks[b.index] = t;
+  }, pool);
+  return blocks;
+}
+
+} // namespace
+
+TEST(sfinx, short_rate_paths)
+{
+  using namespace sfinx::interest_rate;
+
+  // noncentral chi-square, both representations: mean d + lambda, variance 2 (d + 2 lambda)
+  size_t const n = 1 << 16;
+  for (auto dl : { std::make_pair(3.0, 2.0), std::make_pair(0.5, 3.0), std::make_pair(0.5, 40.0) }) {
+    double d = dl.first, l = dl.second, m1 = 0, m2 = 0;
+    for (size_t p = 0; p < n; ++p) {
+      random::path_stream stream(11, p);
+      double x = random::noncentral_chi_square(stream, d, l);
+      EXPECT_GE(x, 0);
+      m1 += x / n;
+      m2 += x * x / n;
+    }
+    double var = 2 * (d + 2 * l);
+    EXPECT_NEAR(m1, d + l, 5 * sqrt(var / n));
+    EXPECT_NEAR(m2 - m1 * m1, var, 0.05 * var);
+  }
+
+  thread_pool pool(3), one(1);
+  path_settings s;
+  s.paths = 20000;
+  s.steps = 2;
+  s.seed = 5;
+  auto check = [&](std::vector<path_sums> const& blocks, double mean, double var) {
+    double m = 0, v = 0;
+    for (path_sums const& b : blocks) {
+      m += b.r / s.paths;
+      v += b.rr / s.paths;
+    }
+    v -= m * m;
+    EXPECT_NEAR(m, mean, 5 * sqrt(var / s.paths));
+    EXPECT_NEAR(v, var, 5 * sqrt(2.0 / s.paths) * var);
+  };
+  auto price = [&](std::vector<path_sums> const& blocks, double P) {
+    double m = 0, v = 0;
+    for (path_sums const& b : blocks) {
+      m += b.df / s.paths;
+      v += b.dfdf / s.paths;
+    }
+    EXPECT_NEAR(m, P, 5 * sqrt((v - m * m) / s.paths));
+  };
+
+  // two steps to T = 5, exact whatever their length
+  double T = 5;
+  short_rate_params v = { 0.03, 0.15, 0.05, 0.02 };
+  check(simulate_sums(vasicek_process(v, T / s.steps), s, pool),
+        v.b + (v.r0 - v.b) * exp(-v.a * T), v.sigma * v.sigma * (1 - exp(-2 * v.a * T)) / (2 * v.a));
+  for (short_rate_params c : { short_rate_params{ 0.03, 0.5, 0.04, 0.1 },
+                               short_rate_params{ 0.03, 0.2, 0.02, 0.2 } }) {
+    double e = exp(-c.a * T), s2 = c.sigma * c.sigma;
+    check(simulate_sums(cir_process(c, T / s.steps), s, pool), c.b + (c.r0 - c.b) * e,
+          c.r0 * s2 / c.a * (e - e * e) + c.b * s2 / (2 * c.a) * (1 - e) * (1 - e));
+  }
+  term_structure::nelson_siegel_curve curve = { { 0.04, -0.015, 0.01, 2.0 } };
+  hull_white_params hw = { 0.1, 0.015 };
+  double B = (1 - exp(-hw.a * T)) / hw.a;
+  check(simulate_sums(hull_white_process(curve, hw, T / s.steps, s.steps), s, pool),
+        interest_rate::aux::forward(curve, T) + hw.sigma * hw.sigma * B * B / 2,
+        hw.sigma * hw.sigma * (1 - exp(-2 * hw.a * T)) / (2 * hw.a));
+
+  s.steps = 3;
+  EXPECT_THROW(simulate_sums(hull_white_process(curve, hw, T / 2, 2), s, pool),
+               std::invalid_argument);
+  s.steps = 2;
+
+  // the same blocks on any pool
+  auto a = simulate_sums(cir_process(short_rate_params{ 0.03, 0.2, 0.02, 0.2 }, 1.0), s, pool);
+  auto b = simulate_sums(cir_process(short_rate_params{ 0.03, 0.2, 0.02, 0.2 }, 1.0), s, one);
+  for (size_t j = 0; j < a.size(); ++j) {
+    EXPECT_EQ(a[j].r, b[j].r);
+    EXPECT_EQ(a[j].df, b[j].df);
+  }
+
+  // pathwise discounting on a fine grid prices the zero coupon bonds
+  s.steps = 64;
+  T = 2;
+  price(simulate_sums(vasicek_process(v, T / s.steps), s, pool),
+        vasicek(T, v.r0, v.a, v.b, v.sigma));
+  short_rate_params c = { 0.03, 0.5, 0.04, 0.1 };
+  price(simulate_sums(cir_process(c, T / s.steps), s, pool),
+        cox_ingersoll_ross(T, c.r0, c.a, c.b, c.sigma));
+  price(simulate_sums(hull_white_process(curve, hw, T / s.steps, s.steps), s, pool), curve.df(T));
+}
+
+TEST(sfinx, simd_math)
+{
+  double x[] = { -745.0, -30.0, -4.5, -1.0, -0.3, 0.0, 1.0e-300, 0.25, 0.5, 3.0, 4.0, 12.0, 26.0, 700.0 };
+  for (double xi : x) {
+    double e[simd::pack::size], c[simd::pack::size];
+    simd::exp(xi).store(e);
+    simd::erfc(xi).store(c);
+    EXPECT_NEAR(e[0], exp(xi), 4.0e-16 * exp(xi));
+    EXPECT_NEAR(c[0], erfc(xi), 1.0e-15 * erfc(xi));
+    if (xi > 0) {
+      double l[simd::pack::size];
+      simd::log(xi).store(l);
+      EXPECT_NEAR(l[0], log(xi), 4.0e-16 * fabs(log(xi)));
+    }
+  }
+}
@@ -10,3 +10,110 @@ namespace eigen_test {
 }
 
 
+
+#include "longstaff_schwartz.hpp"
+
+TEST(option, longstaff_schwartz)
+{
+  using namespace sfinx;
+  using option::Type;
+
+  // American put against a 2000 step lattice, 12.30976, and above the European
+  double S = 100, X = 105, T = .75, r = .05, b = .02, v = .3;
+  lsm::settings s;
+  s.paths = 1 << 15;
+  s.dates = 50;
+  auto a = lsm::value<lsm::polynomial<4>>(lsm::vanilla<Type::Put>{X}, S, T, r, b, v, s);
+  EXPECT_EQ(a.paths, s.paths);
+  EXPECT_NEAR(a.value, 12.30976, 4 * a.error + 0.03);
+  EXPECT_GT(a.value, bsm_general::put(S, X, T, r, b, v) + 0.1);
+
+  // same numbers on any pool size
+  thread_pool pool(3);
+  auto p = lsm::value<lsm::polynomial<4>>(lsm::vanilla<Type::Put>{X}, S, T, r, b, v, s, pool);
+  EXPECT_EQ(a.value, p.value);
+  EXPECT_EQ(a.error, p.error);
+
+  // Bermudan max call on two assets, Glasserman (2004) 13.90
+  double S0[] = { 100, 100 }, b0[] = { -.05, -.05 }, v0[] = { .2, .2 };
+  lsm::correlation rho = lsm::correlation::Identity(2, 2);
+  s.dates = 9;
+  s.paths = 1 << 16;
+  auto m = lsm::value<lsm::quadratic<2>>(lsm::rainbow<Type::Call>{100}, S0, b0, v0, rho, 3, .05,
+                                         s, pool);
+  EXPECT_NEAR(m.value, 13.90, 4 * m.error + 0.05);
+
+  // a basket of perfectly correlated assets is the single asset
+  double w[] = { .5, .5 }, S1[] = { 90, 110 }, v1[] = { .3, .3 }, b1[] = { .02, .02 };
+  rho << 1, 1, 1, 1;
+  rho(1, 1) += 1e-12;
+  s.dates = 20;
+  s.paths = 1 << 14;
+  auto k = lsm::value<lsm::polynomial<4>>(lsm::basket<Type::Put>{X, w}, S1, b1, v1, rho, T, r,
+                                          s, pool);
+  EXPECT_NEAR(k.value, a.value, 4 * (k.error + a.error) + 0.05);
+}
+
+#include "curve_fit.hpp"
+
+TEST(term_structure, fit)
+{
+  using namespace sfinx;
+  using namespace sfinx::term_structure;
+
+  // analytic gradients against central differences
+  double p4[] = { 0.04, -0.02, 0.015, 1.7 }, p6[] = { 0.04, -0.02, 0.015, -0.01, 1.7, 6.0 };
+  for (double t : { 0.0, 0.3, 2.0, 15.0 }) {
+    double g[6], gp[6], q[6];
+    term_structure::aux::nelson_siegel_model::rate(p4, t, g);
+    for (int k = 0; k < 4; ++k) {
+      std::copy(p4, p4 + 4, q);
+      q[k] += 1.0e-6;
+      double up = term_structure::aux::nelson_siegel_model::rate(q, t, gp);
+      q[k] -= 2.0e-6;
+      double down = term_structure::aux::nelson_siegel_model::rate(q, t, gp);
+      EXPECT_NEAR(g[k], (up - down) / 2.0e-6, 1.0e-8);
+    }
+    term_structure::aux::svensson_model::rate(p6, t, g);
+    for (int k = 0; k < 6; ++k) {
+      std::copy(p6, p6 + 6, q);
+      q[k] += 1.0e-6;
+      double up = term_structure::aux::svensson_model::rate(q, t, gp);
+      q[k] -= 2.0e-6;
+      double down = term_structure::aux::svensson_model::rate(q, t, gp);
+      EXPECT_NEAR(g[k], (up - down) / 2.0e-6, 1.0e-8);
+    }
+  }
+
+  std::vector<double> t = { 0.25, 0.5, 1, 2, 3, 4, 5, 7, 10, 15, 20, 30 }, y, moved;
+  nelson_siegel_params ns = { 0.045, -0.025, 0.02, 1.8 };
+  for (double ti : t)
+    y.push_back(nelson_siegel(ti, ns.b0, ns.b1, ns.b2, ns.lambda));
+  std::vector<double> lambdas = { 0.5, 1, 2, 4, 8 };
+  thread_pool pool(2);
+  auto cold = fit_nelson_siegel(t, y, lambdas, pool);
+  EXPECT_TRUE(cold.converged);
+  EXPECT_LT(cold.rmse, 1.0e-12);
+  EXPECT_NEAR(cold.params.lambda, ns.lambda, 1.0e-8);
+  EXPECT_NEAR(cold.params.b2, ns.b2, 1.0e-9);
+
+  // intraday refit after a twist of a few basis points
+  for (size_t i = 0; i < t.size(); ++i)
+    moved.push_back(y[i] + 1.0e-4 * (1 + 0.1 * t[i]) * exp(-t[i] / 10));
+  auto warm = fit_nelson_siegel(t, moved, cold.params);
+  auto refit = fit_nelson_siegel(t, moved, lambdas, pool);
+  EXPECT_TRUE(warm.converged);
+  EXPECT_LE(warm.iterations, 6u);
+  EXPECT_NEAR(warm.rmse, refit.rmse, 1.0e-12);
+
+  svensson_params sv = { 0.04, -0.02, 0.015, -0.01, 1.2, 7.0 };
+  y.clear();
+  for (double ti : t)
+    y.push_back(svensson(ti, sv.b0, sv.b1, sv.b2, sv.b3, sv.t1, sv.t2));
+  std::vector<double> taus = { 0.5, 1, 2, 5, 10 };
+  auto sfit = fit_svensson(t, y, taus, pool);
+  EXPECT_LT(sfit.rmse, 1.0e-10);
+  auto swarm = fit_svensson(t, y, sfit.params);
+  EXPECT_LE(swarm.rmse, sfit.rmse);
+  EXPECT_LE(swarm.iterations, 3u);
+}
@@ -1,7 +1,12 @@
+#include <vector>
 #include <gtest/gtest.h>
 #include "black_scholes.hpp"
 #include "barone_adesi_whaley.hpp"
 #include "bjerksund_stensland.hpp"
+#include "implied_vol.hpp"
+#include "lattice.hpp"
+#include "pde.hpp"
+#include "monte_carlo.hpp"
 
 
 TEST(option, black_scholes)
@@ -96,6 +101,33 @@ TEST(option, barone_adesi_whaley)
   }
 }
 
+TEST(option, barone_adesi_whaley_chain)
+{
+  using namespace sfinx;
+  using option::Type;
+  double S = 100, T = 0.5, r = 0.08, b = -0.04, v = 0.3;
+  size_t const n = 41;
+  std::vector<double> X(n), call(n), put(n);
+  for (size_t i = 0; i < n; ++i)
+    X[i] = 50 + 2.5 * i;
+  baw::cache<> c(2);
+  baw::value<Type::Both>(c, S, X, T, r, b, v, call, put);
+  for (size_t i = 0; i < n; ++i) {
+    EXPECT_NEAR(call[i], baw::call(S, X[i], T, r, b, v), 1.0e-8 * X[i]);
+    EXPECT_NEAR(put[i], baw::put(S, X[i], T, r, b, v), 1.0e-8 * X[i]);
+  }
+  EXPECT_EQ(c.misses(), 2u);
+  baw::value<Type::Call>(c, 95.0, X, T, r, b, v, call);
+  EXPECT_EQ(c.hits(), 1u);
+  baw::value<Type::Call>(c, S, X, T, r, b, 0.2, call);  // evicts the oldest, the v = 0.3 call
+  baw::value<Type::Put>(c, S, X, T, r, b, v, put);
+  EXPECT_EQ(c.hits(), 2u);
+  baw::value<Type::Call>(c, S, X, T, r, b, v, call);
+  EXPECT_EQ(c.misses(), 4u);
+  EXPECT_EQ(c.size(), 2u);
+  EXPECT_NEAR(call[n - 1], baw::call(S, X[n - 1], T, r, b, v), 1.0e-8 * X[n - 1]);
+}
+
 TEST(option, bjerksund_stensland)
 {
   using namespace sfinx;
@@ -119,3 +151,446 @@ TEST(option, bjerksund_stensland)
   }
 }
 
+TEST(option, bjerksund_stensland_put)
+{
+  using namespace sfinx;
+  using option::Type;
+  double X = 100, T = 0.5, r = 0.1, b = 0;
+  // 4000 step binomial values at S = 90 for v = 0.15, 0.25, 0.35
+  double vs[] = { 0.15, 0.25, 0.35 }, calls[] = { 0.8115, 2.7224, 4.9743 },
+         puts[] = { 10.5644, 12.4301, 14.6699 };
+  for (int i = 0; i < 3; ++i) {
+    double S = 90, v = vs[i];
+    auto cp = bs93::value<Type::Both>(S, X, T, r, b, v);
+    EXPECT_EQ(cp.first, bs93::call(S, X, T, r, b, v));
+    EXPECT_EQ(cp.second, bs93::put(S, X, T, r, b, v));
+    EXPECT_EQ(cp.second, bs93::call(X, S, T, r - b, -b, v));
+    EXPECT_GE(cp.second, bsm_general::put(S, X, T, r, b, v));
+    EXPECT_GE(cp.second, X - S);
+
+    auto cp02 = bs02::value<Type::Both>(S, X, T, r, b, v);
+    EXPECT_GE(cp02.first, cp.first);
+    EXPECT_GE(cp02.second, cp.second);
+    EXPECT_LT(fabs(cp02.first - calls[i]), fabs(cp.first - calls[i]));
+    EXPECT_LT(fabs(cp02.second - puts[i]), fabs(cp.second - puts[i]));
+    EXPECT_NEAR(cp02.second, puts[i], 0.03);
+  }
+  // Deep in the money the put is exercised, with r <= 0 it is european
+  EXPECT_EQ(bs93::put(50.0, X, T, r, b, 0.2), 50.0);
+  EXPECT_EQ(bs02::put(50.0, X, T, r, b, 0.2), 50.0);
+  EXPECT_NEAR(bs93::put(90.0, X, T, -0.01, b, 0.2), bsm_general::put(90.0, X, T, -0.01, b, 0.2),
+              1.0e-14);
+}
+
+TEST(option, lattice)
+{
+  using namespace sfinx;
+  using option::Type;
+  using option::Exercise;
+  using lattice::Method;
+  double S = 100, X = 105, T = 0.75, r = 0.05, b = 0.02, v = 0.3;
+  auto e = bsm_general::greeks<Type::Put>(S, X, T, r, b, v);
+  auto crr = lattice::value<Type::Put, Exercise::European, Method::CRR>(S, X, T, r, b, v, 1000);
+  auto lr = lattice::value<Type::Put, Exercise::European, Method::LeisenReimer>(S, X, T, r, b, v, 1000);
+  auto tri = lattice::value<Type::Put, Exercise::European, Method::Trinomial>(S, X, T, r, b, v, 1000);
+  EXPECT_NEAR(crr.value, e.value, 5.0e-3);
+  EXPECT_NEAR(lr.value, e.value, 1.0e-5);
+  EXPECT_NEAR(tri.value, e.value, 1.0e-3);
+  for (auto const& g : { crr, lr, tri }) {
+    EXPECT_NEAR(g.delta, e.delta, 1.0e-4);
+    EXPECT_NEAR(g.gamma, e.gamma, 1.0e-4);
+    EXPECT_NEAR(g.theta, e.theta, 1.0e-2);
+  }
+
+  // American put against a 20001 step Leisen-Reimer tree
+  double ref = 12.30975957;
+  EXPECT_NEAR((lattice::value<Type::Put, Exercise::American, Method::CRR>(S, X, T, r, b, v, 1000).value),
+              ref, 2.0e-3);
+  EXPECT_NEAR((lattice::value<Type::Put, Exercise::American, Method::LeisenReimer>(S, X, T, r, b, v,
+                                                                                  1000).value),
+              ref, 1.0e-4);
+  EXPECT_NEAR((lattice::value<Type::Put, Exercise::American, Method::Trinomial>(S, X, T, r, b, v,
+                                                                               1000).value),
+              ref, 1.0e-3);
+  // a call with b >= r is never exercised early
+  EXPECT_NEAR((lattice::value<Type::Call, Exercise::American, Method::CRR>(S, X, T, r, r, v, 500).value),
+              (lattice::value<Type::Call, Exercise::European, Method::CRR>(S, X, T, r, r, v, 500).value),
+              1.0e-12);
+
+  size_t const n = 13;
+  std::vector<double> Xs(n), val(n), del(n), gam(n), th(n);
+  for (size_t i = 0; i < n; ++i)
+    Xs[i] = 80 + 4 * i;
+  lattice::result<span<double>> out = { val, del, gam, th };
+  lattice::value<Type::Put, Exercise::American, Method::Trinomial>(S, Xs, T, r, b, v, 300, out);
+  for (size_t i = 0; i < n; ++i) {
+    auto g = lattice::value<Type::Put, Exercise::American, Method::Trinomial>(S, Xs[i], T, r, b, v,
+                                                                              300);
+    EXPECT_NEAR(val[i], g.value, 1.0e-12);
+    EXPECT_NEAR(del[i], g.delta, 1.0e-12);
+    EXPECT_NEAR(gam[i], g.gamma, 1.0e-12);
+    EXPECT_NEAR(th[i], g.theta, 1.0e-10);
+  }
+  lattice::result<span<double>> values = { val, {}, {}, {} };
+  lattice::value<Type::Call, Exercise::European, Method::CRR>(S, Xs, T, r, b, v, 301, values);
+  for (size_t i = 0; i < n; ++i)
+    EXPECT_NEAR(val[i], (lattice::value<Type::Call, Exercise::European, Method::CRR>(S, Xs[i], T, r,
+                                                                                    b, v, 301).value),
+                1.0e-12);
+}
+
+TEST(option, pde)
+{
+  using namespace sfinx;
+  using option::Type;
+  using option::Exercise;
+  double S = 100, X = 105, T = 0.75, r = 0.05, b = 0.02, v = 0.3;
+  pde::solver grid(T, r, b, v);
+  grid.solve<Type::Put, Exercise::European>();
+  auto e = bsm_general::greeks<Type::Put>(S, X, T, r, b, v);
+  auto g = grid.at(S, X);
+  EXPECT_NEAR(g.value, e.value, 2.0e-3);
+  EXPECT_NEAR(g.delta, e.delta, 1.0e-4);
+  EXPECT_NEAR(g.gamma, e.gamma, 1.0e-5);
+  EXPECT_NEAR(g.theta, e.theta, 1.0e-2);
+
+  grid.solve<Type::Put>();
+  EXPECT_NEAR(grid.at(S, X).value, 12.30975957, 2.0e-3);
+
+  // the factorization is kept for the same parameters and the grid is unit strike
+  grid.reset(T, r, b, v);
+  EXPECT_EQ(grid.factorizations(), 1u);
+  EXPECT_EQ(grid.solves(), 2u);
+  std::vector<double> Xs = { 90, 100, 110, 120 }, val(4), del(4);
+  pde::result<span<double>> chain = { val, del, {}, {} };
+  grid.at(S, Xs, chain);
+  for (size_t i = 0; i < Xs.size(); ++i) {
+    EXPECT_NEAR(2 * val[i], grid.at(2 * S, 2 * Xs[i]).value, 1.0e-12);
+    EXPECT_NEAR(del[i], grid.at(2 * S, 2 * Xs[i]).delta, 1.0e-12);
+  }
+
+  grid.reset(T, r, -0.04, v);
+  EXPECT_EQ(grid.factorizations(), 2u);
+  grid.solve<Type::Call>();
+  auto lr = lattice::value<Type::Call, Exercise::American, lattice::Method::LeisenReimer>(
+      S, X, T, r, -0.04, v, 2001);
+  g = grid.at(S, X);
+  EXPECT_NEAR(g.value, lr.value, 2.0e-3);
+  EXPECT_NEAR(g.delta, lr.delta, 1.0e-4);
+  EXPECT_NEAR(g.gamma, lr.gamma, 1.0e-5);
+  EXPECT_NEAR(g.theta, lr.theta, 1.0e-2);
+
+  // every node of the surface, exercised nodes have no time value
+  size_t n = grid.size();
+  std::vector<double> Sn(n), V(n), D(n), G(n), Th(n);
+  pde::result<span<double>> surface = { V, D, G, Th };
+  grid.surface(X, Sn, surface);
+  for (size_t i = 1; i + 2 < n; ++i) {
+    EXPECT_GE(V[i], std::max(Sn[i] - X, 0.0) - 1.0e-12);
+    EXPECT_NEAR(V[i], grid.at(Sn[i], X).value, 1.0e-9);
+    if (V[i] == Sn[i] - X) {
+      EXPECT_EQ(Th[i], 0.0);
+    }
+  }
+  EXPECT_NEAR(Sn[n / 2], X, 1.0e-12);
+}
+
+TEST(option, monte_carlo)
+{
+  using namespace sfinx;
+  using option::Type;
+  double S = 100, X = 100, T = 1, r = 0.05, b = 0.02, v = 0.25;
+  mc::settings s;
+  s.paths = 1 << 16;
+  s.seed = 42;
+
+  // the same blocks and draws on any number of threads
+  thread_pool pool(3);
+  mc::asian<Type::Call> asian = { X };
+  auto a = mc::value(asian, S, T, r, b, v, s, pool);
+  auto a1 = mc::value(asian, S, T, r, b, v, s);
+  EXPECT_EQ(a.value, a1.value);
+  EXPECT_EQ(a.error, a1.error);
+  EXPECT_EQ(a.paths, size_t(1 << 16));
+
+  s.antithetic = s.control = false;
+  auto plain = mc::value(asian, S, T, r, b, v, s, pool);
+  EXPECT_LT(a.error, plain.error);
+  EXPECT_NEAR(a.value, plain.value, 3 * plain.error);
+
+  // one fixing is the vanilla
+  s.steps = 1;
+  auto e = mc::value(mc::asian<Type::Put>{ X }, S, T, r, b, v, s, pool);
+  EXPECT_NEAR(e.value, bsm_general::put(S, X, T, r, b, v), 3 * e.error);
+
+  // in and out regress on the same control, together they are the closed form vanilla
+  s.steps = 50;
+  s.control = true;
+  auto in = mc::value(mc::barrier<Type::Put, mc::Barrier::DownIn>{ X, 85 }, S, T, r, b, v, s, pool);
+  auto out = mc::value(mc::barrier<Type::Put, mc::Barrier::DownOut>{ X, 85 }, S, T, r, b, v, s,
+                       pool);
+  EXPECT_NEAR(in.value + out.value, bsm_general::put(S, X, T, r, b, v), 1.0e-10);
+  EXPECT_GT(in.value, out.value);
+
+  auto lb = mc::value(mc::lookback<Type::Call>{}, S, T, r, b, v, s, pool);
+  EXPECT_GT(lb.value, bsm_general::call(S, S, T, r, b, v));
+
+  // Sobol points through the bridge, a sixteenth of the paths for the same accuracy
+  s.quasi = true;
+  s.control = s.antithetic = false;
+  s.paths = 4096;
+  s.steps = 16;
+  auto qe = mc::value(mc::barrier<Type::Call, mc::Barrier::DownOut>{ X, 1 }, S, T, r, b, v, s);
+  EXPECT_NEAR(qe.value, bsm_general::call(S, X, T, r, b, v), 5.0e-3);
+  s.steps = 12;
+  auto qa = mc::value(asian, S, T, r, b, v, s, pool);
+  EXPECT_NEAR(qa.value, a.value, 0.03);
+  EXPECT_EQ(qa.value, mc::value(asian, S, T, r, b, v, s).value);
+}
+
+TEST(option, normal_policy)
+{
+  using namespace sfinx;
+  using option::Type;
+  double S = 90, X = 100, T = 0.5, r = 0.1, b = 0, v = 0.25;
+  double bsm = bsm_general::put(S, X, T, r, b, v);
+  EXPECT_NEAR(bsm_general::put<normal::rational>(S, X, T, r, b, v), bsm, 1.0e-12);
+  EXPECT_NEAR(bsm_general::put<normal::fast>(S, X, T, r, b, v), bsm, 2.0e-7 * (S + X));
+  double baw = baw::call(S, X, T, r, b, v);
+  EXPECT_NEAR(baw::call<normal::rational>(S, X, T, r, b, v), baw, 1.0e-10);
+  EXPECT_NEAR(baw::call<normal::fast>(S, X, T, r, b, v), baw, 1.0e-4);
+  double bs93 = bs93::call(S, X, T, r, b, v);
+  EXPECT_NEAR(bs93::call<normal::rational>(S, X, T, r, b, v), bs93, 1.0e-10);
+  EXPECT_NEAR(bs93::call<normal::fast>(S, X, T, r, b, v), bs93, 1.0e-4);
+
+  auto g = bs::greeks<Type::Call, normal::fast>(S, X, T, r, v);
+  EXPECT_NEAR(g.delta, bs::delta<Type::Call>(S, X, T, r, v), 2.0e-7);
+
+  size_t const n = 21;
+  std::vector<double> Sv(n, S), Xv(n), Tv(n, T), rv(n, r), vv(n, v), out(n);
+  for (size_t i = 0; i < n; ++i)
+    Xv[i] = 80 + 2 * i;
+  bs::value<Type::Call, normal::fast>(Sv, Xv, Tv, rv, vv, out);
+  for (size_t i = 0; i < n; ++i)
+    EXPECT_NEAR(out[i], bs::call(S, Xv[i], T, r, v), 2.0e-7 * (S + Xv[i]));
+}
+
+TEST(option, american_greeks)
+{
+  using namespace sfinx;
+  using option::Type;
+  // Central differences of the value, the BAW boundary is only solved to 1e-6 relative
+  double X = 100, T = 0.5, r = 0.08, b = -0.04, v = 0.3, h = 1.0e-4;
+  for (double S : { 70.0, 90.0, 100.0, 110.0, 130.0 }) {
+    auto c = bs93::greeks<Type::Call>(S, X, T, r, b, v);
+    EXPECT_NEAR(c.value, bs93::call(S, X, T, r, b, v), 1.0e-12);
+    double up = bs93::call(S * (1 + h), X, T, r, b, v), dn = bs93::call(S * (1 - h), X, T, r, b, v);
+    EXPECT_NEAR(c.delta, (up - dn) / (2 * S * h), 1.0e-6);
+    EXPECT_NEAR(c.gamma, (up - 2 * c.value + dn) / (S * S * h * h), 1.0e-4);
+    EXPECT_NEAR(c.vega, (bs93::call(S, X, T, r, b, v + h) - bs93::call(S, X, T, r, b, v - h)) / (2 * h),
+                1.0e-5);
+    EXPECT_NEAR(c.theta, -(bs93::call(S, X, T + h, r, b, v) - bs93::call(S, X, T - h, r, b, v)) / (2 * h),
+                1.0e-5);
+    EXPECT_NEAR(c.rho, (bs93::call(S, X, T, r + h, b, v) - bs93::call(S, X, T, r - h, b, v)) / (2 * h),
+                1.0e-5);
+    EXPECT_NEAR(c.carry, (bs93::call(S, X, T, r, b + h, v) - bs93::call(S, X, T, r, b - h, v)) / (2 * h),
+                1.0e-5);
+    EXPECT_NEAR(c.vanna, (bs93::greeks<Type::Call>(S, X, T, r, b, v + h).delta
+                          - bs93::greeks<Type::Call>(S, X, T, r, b, v - h).delta) / (2 * h), 1.0e-5);
+
+    auto p = baw::greeks<Type::Put>(S, X, T, r, b, v);
+    EXPECT_NEAR(p.value, baw::put(S, X, T, r, b, v), 1.0e-12);
+    up = baw::put(S * (1 + h), X, T, r, b, v), dn = baw::put(S * (1 - h), X, T, r, b, v);
+    EXPECT_NEAR(p.delta, (up - dn) / (2 * S * h), 1.0e-6);
+    EXPECT_NEAR(p.gamma, (up - 2 * p.value + dn) / (S * S * h * h), 1.0e-4);
+    h = 1.0e-3;
+    EXPECT_NEAR(p.vega, (baw::put(S, X, T, r, b, v + h) - baw::put(S, X, T, r, b, v - h)) / (2 * h),
+                1.0e-3);
+    EXPECT_NEAR(p.theta, -(baw::put(S, X, T + h, r, b, v) - baw::put(S, X, T - h, r, b, v)) / (2 * h),
+                1.0e-3);
+    EXPECT_NEAR(p.rho, (baw::put(S, X, T, r + h, b, v) - baw::put(S, X, T, r - h, b, v)) / (2 * h),
+                1.0e-3);
+    h = 1.0e-4;
+    auto c2 = baw::greeks<Type::Call>(S, X, T, r, b, v);
+    EXPECT_NEAR(c2.value, baw::call(S, X, T, r, b, v), 1.0e-12);
+    EXPECT_NEAR(c2.vega, (baw::call(S, X, T, r, b, v + 1.0e-3) - baw::call(S, X, T, r, b, v - 1.0e-3))
+                / 2.0e-3, 1.0e-3);
+  }
+
+  size_t const n = 9;
+  std::vector<double> S(n), Xv(n, X), Tv(n, T), rv(n, r), bv(n, b), vv(n, v);
+  for (size_t i = 0; i < n; ++i)
+    S[i] = 60 + 10 * i;
+  std::vector<std::vector<double>> cols(10, std::vector<double>(n));
+  option::greeks<span<double>> out = { cols[0], cols[1], cols[2], cols[3], cols[4],
+                                       cols[5], cols[6], cols[7], cols[8], cols[9] };
+  baw::greeks<Type::Put>(S, Xv, Tv, rv, bv, vv, out);
+  for (size_t i = 0; i < n; ++i)
+    EXPECT_EQ(out.theta[i], baw::greeks<Type::Put>(S[i], X, T, r, b, v).theta);
+  bs93::greeks<Type::Call>(S, Xv, Tv, rv, bv, vv, out);
+  for (size_t i = 0; i < n; ++i)
+    EXPECT_EQ(out.gamma[i], bs93::greeks<Type::Call>(S[i], X, T, r, b, v).gamma);
+}
+
+TEST(option, black_scholes_batch)
+{
+  using namespace sfinx;
+  using option::Type;
+  size_t const n = 1003; // not a multiple of the pack width, the tail goes through a partial pack
+  std::vector<double> S(n), X(n), T(n), r(n), b(n), v(n);
+  for (size_t i = 0; i < n; ++i) {
+    S[i] = 100; X[i] = 40 + 0.15 * i; T[i] = 0.05 + (i % 23) * 0.1;
+    r[i] = 0.001 * (i % 11); b[i] = r[i] - 0.02; v[i] = 0.05 + 0.01 * (i % 37);
+  }
+  std::vector<double> call(n), put(n), c(n), p(n);
+  bs::value<Type::Both>(S, X, T, r, v, call, put);
+  bs::value<Type::Call>(S, X, T, r, v, c);
+  bs::value<Type::Put>(S, X, T, r, v, p);
+  double eps = 1.0e-10;
+  for (size_t i = 0; i < n; ++i) {
+    EXPECT_NEAR(call[i], bs::call(S[i], X[i], T[i], r[i], v[i]), eps);
+    EXPECT_NEAR(put[i], bs::put(S[i], X[i], T[i], r[i], v[i]), eps);
+    EXPECT_EQ(call[i], c[i]);
+    EXPECT_EQ(put[i], p[i]);
+  }
+  bsm_general::call(S, X, T, r, b, v, c);
+  bsm_general::put(S, X, T, r, b, v, p);
+  for (size_t i = 0; i < n; ++i) {
+    EXPECT_NEAR(c[i], bsm_general::call(S[i], X[i], T[i], r[i], b[i], v[i]), eps);
+    EXPECT_NEAR(p[i], bsm_general::put(S[i], X[i], T[i], r[i], b[i], v[i]), eps);
+  }
+}
+
+TEST(option, black_scholes_greeks)
+{
+  using namespace sfinx;
+  using option::Type;
+  double S = 45, X = 50, T = 0.50, r = 0.01, v = 0.20;
+  double eps = 1.0e-12;
+  auto cp = bs::greeks<Type::Both>(S, X, T, r, v);
+  auto c = bs::greeks<Type::Call>(S, X, T, r, v);
+  EXPECT_NEAR(c.value, bs::call(S, X, T, r, v), eps);
+  EXPECT_NEAR(c.delta, bs::delta<Type::Call>(S, X, T, r, v), eps);
+  EXPECT_NEAR(c.gamma, bs::gamma(S, X, T, r, v), eps);
+  EXPECT_NEAR(c.vega, bs::vega(S, X, T, r, v), eps);
+  EXPECT_NEAR(c.theta, bs::theta<Type::Call>(S, X, T, r, v), eps);
+  EXPECT_NEAR(c.rho, bs::rho<Type::Call>(S, X, T, r, v), eps);
+  EXPECT_EQ(cp.first.value, c.value);
+  EXPECT_EQ(cp.first.charm, c.charm);
+  auto p = cp.second;
+  EXPECT_NEAR(p.value, bs::put(S, X, T, r, v), eps);
+  EXPECT_NEAR(p.delta, bs::delta<Type::Put>(S, X, T, r, v), eps);
+  EXPECT_NEAR(p.theta, bs::theta<Type::Put>(S, X, T, r, v), eps);
+  EXPECT_NEAR(p.rho, bs::rho<Type::Put>(S, X, T, r, v), eps);
+
+  // Second order and carry sensitivities against central differences
+  double b = -0.02, h = 1.0e-4, fd = 1.0e-6;
+  for (auto g : { bsm_general::greeks<Type::Call>(S, X, T, r, b, v),
+                  bsm_general::greeks<Type::Put>(S, X, T, r, b, v) }) {
+    bool call = g.delta > 0;
+    auto value = [&](double S, double T, double r, double b, double v) {
+      return call ? bsm_general::call(S, X, T, r, b, v) : bsm_general::put(S, X, T, r, b, v);
+    };
+    auto delta = [&](double T, double v) {
+      return (value(S + h, T, r, b, v) - value(S - h, T, r, b, v)) / (2 * h);
+    };
+    EXPECT_NEAR(g.vanna, (delta(T, v + h) - delta(T, v - h)) / (2 * h), fd);
+    EXPECT_NEAR(g.charm, -(delta(T + h, v) - delta(T - h, v)) / (2 * h), fd);
+    EXPECT_NEAR(g.volga, (value(S, T, r, b, v + h) - 2 * g.value + value(S, T, r, b, v - h)) / (h * h), 1.0e-3);
+    EXPECT_NEAR(g.theta, -(value(S, T + h, r, b, v) - value(S, T - h, r, b, v)) / (2 * h), fd);
+    EXPECT_NEAR(g.rho, (value(S, T, r + h, b, v) - value(S, T, r - h, b, v)) / (2 * h), fd);
+    EXPECT_NEAR(g.carry, (value(S, T, r, b + h, v) - value(S, T, r, b - h, v)) / (2 * h), fd);
+  }
+}
+
+TEST(option, black_scholes_greeks_batch)
+{
+  using namespace sfinx;
+  using option::Type;
+  size_t const n = 77;
+  std::vector<double> S(n, 100), X(n), T(n), r(n, 0.03), v(n);
+  for (size_t i = 0; i < n; ++i) {
+    X[i] = 60 + i; T[i] = 0.1 + 0.05 * (i % 13); v[i] = 0.1 + 0.01 * (i % 17);
+  }
+  std::vector<std::vector<double>> cols(20, std::vector<double>(n));
+  option::greeks<span<double>> call = { cols[0], cols[1], cols[2], cols[3], cols[4],
+                                        cols[5], cols[6], cols[7], cols[8], cols[9] };
+  option::greeks<span<double>> put = { cols[10], cols[11], cols[12], cols[13], cols[14],
+                                       cols[15], cols[16], cols[17], cols[18], cols[19] };
+  bs::greeks<Type::Both>(S, X, T, r, v, call, put);
+  double eps = 1.0e-12;
+  for (size_t i = 0; i < n; ++i) {
+    auto c = bs::greeks<Type::Call>(S[i], X[i], T[i], r[i], v[i]);
+    auto p = bs::greeks<Type::Put>(S[i], X[i], T[i], r[i], v[i]);
+    EXPECT_NEAR(call.value[i], c.value, eps);
+    EXPECT_NEAR(call.delta[i], c.delta, eps);
+    EXPECT_NEAR(call.gamma[i], c.gamma, eps);
+    EXPECT_NEAR(call.volga[i], c.volga, eps * (1 + fabs(c.volga)));
+    EXPECT_NEAR(put.value[i], p.value, eps);
+    EXPECT_NEAR(put.theta[i], p.theta, 1.0e-10);
+    EXPECT_NEAR(put.charm[i], p.charm, 1.0e-10);
+    EXPECT_NEAR(put.rho[i], p.rho, 1.0e-10);
+  }
+}
+
+TEST(option, implied_vol)
+{
+  using namespace sfinx;
+  using option::Type;
+  double S = 100, T = 0.75, r = 0.03, eps = 1.0e-10;
+  for (double X : { 40.0, 80.0, 100.0, 125.0, 200.0 })
+    for (double v : { 0.05, 0.2, 0.6, 1.5 }) {
+      double call = bs::call(S, X, T, r, v), put = bs::put(S, X, T, r, v);
+      // Out of the money quotes are solved directly, in the money ones need enough time value
+      // left after parity to pin the volatility
+      auto c = bs::implied_vol<Type::Call>(call, S, X, T, r);
+      auto p = bs::implied_vol<Type::Put>(put, S, X, T, r);
+      auto otm = X > S ? c : p;
+      EXPECT_EQ(otm.status, iv::Status::Converged);
+      EXPECT_NEAR(otm.vol, v, eps);
+      EXPECT_LE(otm.iterations, 6u);
+      if (std::min(call, put) > 1.0e-6) {
+        EXPECT_NEAR(c.vol, v, eps);
+        EXPECT_NEAR(p.vol, v, eps);
+      }
+    }
+  auto g = bsm_general::implied_vol<Type::Put>(bsm_general::put(75., 70., 0.5, 0.1, 0.05, 0.35),
+                                               75., 70., 0.5, 0.1, 0.05);
+  EXPECT_NEAR(g.vol, 0.35, eps);
+
+  // No volatility reproduces prices outside the no-arbitrage bounds
+  EXPECT_EQ(bs::implied_vol<Type::Call>(0.5, 120., 100., T, r).status, iv::Status::BelowIntrinsic);
+  EXPECT_EQ(bs::implied_vol<Type::Call>(101., 100., 100., T, r).status, iv::Status::AboveBound);
+  EXPECT_EQ(bs::implied_vol<Type::Put>(100., 100., 100., T, r).status, iv::Status::AboveBound);
+  EXPECT_TRUE(std::isnan(bs::implied_vol<Type::Put>(0.0, 100., 150., T, r).vol));
+}
+
+TEST(option, implied_vol_batch)
+{
+  using namespace sfinx;
+  using option::Type;
+  size_t const n = 203;
+  std::vector<double> price(n), S(n, 100), X(n), T(n), r(n, 0.02), v(n), vol(n);
+  std::vector<unsigned> iterations(n);
+  std::vector<iv::Status> status(n);
+  for (size_t i = 0; i < n; ++i) {
+    X[i] = 60 + 0.4 * i; T[i] = 0.1 + 0.1 * (i % 19); v[i] = 0.08 + 0.02 * (i % 29);
+    price[i] = bs::put(S[i], X[i], T[i], r[i], v[i]);
+  }
+  price[5] = std::max(X[5] * exp(-r[5] * T[5]) - S[5], 0.0) - 0.01;
+  bs::implied_vol<Type::Put>(price, S, X, T, r, vol, iterations, status);
+  for (size_t i = 0; i < n; ++i) {
+    auto res = bs::implied_vol<Type::Put>(price[i], S[i], X[i], T[i], r[i]);
+    EXPECT_EQ(status[i], res.status);
+    if (i == 5) {
+      EXPECT_EQ(status[i], iv::Status::BelowIntrinsic);
+      continue;
+    }
+    EXPECT_EQ(status[i], iv::Status::Converged);
+    EXPECT_NEAR(vol[i], res.vol, 1.0e-12);
+    EXPECT_LE(iterations[i], 6u);
+    if (bs::call(S[i], X[i], T[i], r[i], v[i]) > 1.0e-6) {
+      EXPECT_NEAR(vol[i], v[i], 1.0e-10);
+    }
+  }
+}
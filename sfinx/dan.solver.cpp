@@ -1,7 +1,13 @@
 #include <array>
 #include <tuple>
+#include <functional>
+#include <cmath>
+#include <limits>
+#include <vector>
 #include <gtest/gtest.h>
 #include "solver.hpp"
+#include "pv.hpp"
+#include "barone_adesi_whaley.hpp"
 
 using namespace sfinx::solver;
 
@@ -26,6 +32,96 @@ TEST(solver, bisection)
   EXPECT_EQ(res.second, 5.0);
 }
 
+TEST(solver, bisection_evaluations)
+{
+  // the two ends and one evaluation per halving
+  trace t;
+  auto f = [](double x) { return x - std::acos(-1.0); };
+  auto res = bisection(f, std::make_pair(0.0, 4.0), 1e-9, 1000, &t);
+  EXPECT_EQ(t.evaluations, t.iterations + 2);
+  EXPECT_LE(t.lo, res.first);
+  EXPECT_GE(t.hi, res.first);
+  EXPECT_LE(t.hi - t.lo, 4e-9);
+}
+
+TEST(solver, bracketing)
+{
+  double eps = 1e-12;
+  auto f = [](double x) { return x * x - 4; };
+  auto g = [](double x) { return std::exp(x) - 1000 * x; };   // roots 0.0010010 and 9.1180
+  trace t;
+  for (int k = 0; k < 3; ++k) {
+    auto solve = [&](std::pair<double, double> r, trace* tr) {
+      return k == 0 ? brent(f, r, eps, 1000, tr) : k == 1 ? ridders(f, r, eps, 1000, tr)
+                                                           : illinois(f, r, eps, 1000, tr);
+    };
+    auto res = solve(std::make_pair(0.0, 10.0), &t);
+    EXPECT_NEAR(res.first, 2.0, 1e-12);
+    EXPECT_EQ(res.second, f(res.first));
+    EXPECT_LE(t.lo, res.first);
+    EXPECT_GE(t.hi, res.first);
+    EXPECT_LT(t.evaluations, 20u);
+    res = solve(std::make_pair(10.0, 1.0), &t);
+    EXPECT_NEAR(res.first, 2.0, 1e-12);
+    // no sign change, the better end
+    res = solve(std::make_pair(3.0, 10.0), nullptr);
+    EXPECT_EQ(res.first, 3.0);
+    EXPECT_EQ(res.second, 5.0);
+  }
+  EXPECT_NEAR(brent(g, std::make_pair(5.0, 20.0), eps).first, 9.1180064, 1e-7);
+  EXPECT_NEAR(ridders(g, std::make_pair(5.0, 20.0), eps).first, 9.1180064, 1e-7);
+  EXPECT_NEAR(illinois(g, std::make_pair(5.0, 20.0), eps).first, 9.1180064, 1e-7);
+  EXPECT_NEAR(brent(g, std::make_pair(0.0, 1.0), eps).first, 0.0010010, 1e-7);
+
+  auto res = secant(f, std::make_pair(3.0, 4.0), eps, 1000, &t);
+  EXPECT_NEAR(res.first, 2.0, 1e-12);
+  EXPECT_LT(t.evaluations, 12u);
+  EXPECT_TRUE(std::isnan(t.lo));
+}
+
+/**
+ * Evaluations to |f| < 1e-10 on the objectives the library solves: the irr of a 10 year
+ * bond, the yield of a 30 year semiannual bond at 85 and the critical price of a
+ * Barone-Adesi-Whaley call: the bracketing solvers beat bisection by a wide margin. The table
+ * of counts is printed by bench.solver.cpp.
+ **/
+TEST(solver, evaluations)
+{
+  using namespace sfinx;
+  std::vector<double> t1, c1, t2, c2;
+  for (int i = 0; i <= 10; ++i) {
+    t1.push_back(i);
+    c1.push_back(i == 0 ? -100 : i == 10 ? 108 : 8);
+  }
+  for (int i = 1; i <= 60; ++i) {
+    t2.push_back(i / 2.0);
+    c2.push_back(i == 60 ? 102.5 : 2.5);
+  }
+  auto irr = [&](double r) { return pv<Flow::Discrete>(t1, c1, r); };
+  auto ytm = [&](double r) { return 85 - pv<Flow::Discrete>(t2, c2, r); };
+  double X = 100, T = .5, r = .08, b = -.04, v = .2;
+  double q = baw::aux::q2((2 * b) / (v * v), (2 * r) / (v * v), 1 - std::exp(-r * T));
+  auto critical = [&](double S) {
+    double d1 = bsm_general::d1(S, X, T, b, v);
+    return S - X - baw::aux::rhs(d1, S, X, T, r, b, v, q);
+  };
+
+  double eps = 1e-10;
+  auto row = [&](std::function<double(double)> f, double a, double b) {
+    trace tb, ti, tr, tt;
+    double x = bisection(f, std::make_pair(a, b), eps, 1000, &tb).first;
+    EXPECT_NEAR(illinois(f, std::make_pair(a, b), eps, 1000, &ti).first, x, 1e-8);
+    EXPECT_NEAR(ridders(f, std::make_pair(a, b), eps, 1000, &tr).first, x, 1e-8);
+    EXPECT_NEAR(brent(f, std::make_pair(a, b), eps, 1000, &tt).first, x, 1e-8);
+    EXPECT_LT(tt.evaluations * 3, tb.evaluations);
+    EXPECT_LT(ti.evaluations * 2, tb.evaluations);
+    EXPECT_LT(tr.evaluations * 2, tb.evaluations);
+  };
+  row(irr, 0.0, 1.0);
+  row(ytm, 0.0, 1.0);
+  row(critical, X, 10 * X);
+}
+
 TEST(solver, newton)
 {
   double eps = 0.00001;
@@ -35,3 +131,77 @@ TEST(solver, newton)
   EXPECT_NEAR(root, 2.0, eps);
 }
 
+
+TEST(solver, halley)
+{
+  double eps = 1e-14;
+  auto f = [](double x) { return std::make_tuple(x * x - 4, 2 * x, 2.0); };
+  auto inf = std::numeric_limits<double>::infinity();
+  trace t;
+  auto res = halley(f, 5.0, std::make_pair(-inf, inf), eps, 100, &t);
+  EXPECT_NEAR(res.first, 2.0, eps);
+  EXPECT_LE(t.evaluations, 5u);
+  EXPECT_EQ(t.evaluations, t.iterations + 1);
+
+  // Newton from 20 lands below the domain bound 0, the step is pulled back halfway
+  auto g = [](double x) { return std::make_tuple(std::log(x) - 2, 1 / x, -1 / (x * x)); };
+  res = halley(g, 40.0, std::make_pair(0.0, 100.0), eps, 100, &t);
+  EXPECT_NEAR(res.first, std::exp(2.0), 1e-12);
+
+  // the bracket of sign changes keeps the iteration off the flat tails of atan
+  auto h = [](double x) { return std::make_tuple(std::atan(x), 1 / (1 + x * x),
+                                                 -2 * x / ((1 + x * x) * (1 + x * x))); };
+  res = halley(h, 3.0, std::make_pair(-inf, inf), eps, 100, &t);
+  EXPECT_NEAR(res.first, 0.0, 1e-12);
+  EXPECT_LT(t.iterations, 10u);
+  EXPECT_LE(t.lo, res.first);
+  EXPECT_GE(t.hi, res.first);
+}
+
+TEST(solver, batch)
+{
+  using namespace sfinx;
+  // yields of 1001 ten year annual bonds, coupons 0% to 10% priced at 60 to 140
+  size_t n = 1001;
+  std::vector<double> coupon(n), price(n), lo(n, -0.5), hi(n, 1.0), root(n);
+  std::vector<unsigned> iterations(n);
+  std::vector<Status> status(n);
+  for (size_t i = 0; i < n; ++i) {
+    coupon[i] = 10.0 * i / (n - 1);
+    price[i] = 60 + 80.0 * ((i * 7919) % n) / n;
+  }
+  auto f = [&](simd::pack r, size_t i) {
+    simd::pack c = simd::load(coupon, i), p = simd::load(price, i), v = -p, d = 1 / (1 + r);
+    simd::pack df = d;
+    for (int t = 1; t <= 10; ++t, df = df * d)
+      v = v + (t == 10 ? c + 100 : c) * df;
+    return v;
+  };
+  solve(f, lo, hi, 1e-10, 100, root, iterations, status);
+  size_t total = 0;
+  for (size_t i = 0; i < n; ++i) {
+    std::vector<double> times, amounts;
+    for (int t = 1; t <= 10; ++t) {
+      times.push_back(t);
+      amounts.push_back(t == 10 ? coupon[i] + 100 : coupon[i]);
+    }
+    EXPECT_EQ(status[i], Status::Converged);
+    EXPECT_NEAR(pv<Flow::Discrete>(times, amounts, root[i]), price[i], 1e-9);
+    total += iterations[i];
+  }
+  EXPECT_LT(total, 10 * n);
+
+  // status codes, and a batch shorter than a pack
+  std::vector<double> a = { 0.0, 3.0, 0.0 }, b = { 10.0, 10.0, 10.0 }, x(3);
+  std::vector<unsigned> its(3);
+  std::vector<Status> st(3);
+  auto g = [](simd::pack y, size_t) { return y * y - 4.0; };
+  solve(g, a, b, 1e-12, 100, x, its, st);
+  EXPECT_EQ(st[0], Status::Converged);
+  EXPECT_NEAR(x[0], 2.0, 1e-12);
+  EXPECT_EQ(st[1], Status::NoBracket);
+  EXPECT_EQ(its[1], 0u);
+  solve(g, a, b, 1e-12, 2, x, its, st);
+  EXPECT_EQ(st[2], Status::MaxIterations);
+  EXPECT_EQ(its[2], 2u);
+}
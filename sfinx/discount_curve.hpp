@@ -0,0 +1,276 @@
+#pragma once
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <vector>
+#include "span.hpp"
+#include "pv.hpp"
+#include "bond.hpp"
+#include "solver.hpp"
+
+namespace sfinx {
+
+enum class Interpolation
+{
+  LinearZero,           // zero rate linear in t, flat zero rate outside the pillars
+  LogLinearDiscount,    // log discount factor linear in t, piecewise flat forwards
+  MonotoneCubic         // Fritsch-Butland monotone cubic on the log discount factor
+};
+
+/**
+ * Discount factors interpolated between pillars, with the origin t = 0, df = 1 as the first
+ * node. Every scheme is stored as one cubic a + h (b + h (c + h d)) per segment in h = t - t_i,
+ * structure of arrays, so a lookup is a search and a Horner step and no slope is recomputed.
+ * Past the last pillar the log discount factor continues with the last forward rate, the
+ * LinearZero curve with the last zero rate.
+ *
+ * df(t, hint) starts the search from the segment of the previous query, which makes streams
+ * of increasing times O(1) a query; the batch df walks its times that way.
+ **/
+class discount_curve
+{
+public:
+  discount_curve(span<double const> times, span<double const> dfs,
+                 Interpolation scheme = Interpolation::LogLinearDiscount)
+    : scheme_(scheme)
+  {
+    reset(times, dfs);
+  }
+
+  /// New pillars, reusing the storage. A NaN discount factor marks a pillar that is not known.
+  void reset(span<double const> times, span<double const> dfs)
+  {
+    assert(times.size() == dfs.size() && !times.empty());
+    size_t n = times.size() + 1;
+    t_.resize(n);
+    a_.resize(n);
+    b_.assign(n, 0.0);
+    c_.assign(n, 0.0);
+    d_.assign(n, 0.0);
+    t_[0] = 0;
+    for (size_t i = 1; i < n; ++i) {
+      t_[i] = times[i - 1];
+      assert(t_[i] > t_[i - 1] && !(dfs[i - 1] <= 0));
+      a_[i] = scheme_ == Interpolation::LinearZero ? -log(dfs[i - 1]) / t_[i] : log(dfs[i - 1]);
+    }
+    a_[0] = scheme_ == Interpolation::LinearZero ? a_[1] : 0.0;
+    for (size_t i = 0; i + 1 < n; ++i)
+      b_[i] = (a_[i + 1] - a_[i]) / (t_[i + 1] - t_[i]);
+    if (scheme_ == Interpolation::MonotoneCubic)
+      hermite();
+    else if (scheme_ == Interpolation::LogLinearDiscount)
+      b_[n - 1] = b_[n - 2];
+  }
+
+  size_t size() const { return t_.size() - 1; }
+  Interpolation scheme() const { return scheme_; }
+
+  /// Pillar times, without the origin
+  span<double const> times() const { return span<double const>(t_.data() + 1, size()); }
+
+  double df(double t) const
+  {
+    size_t k = std::upper_bound(t_.begin() + 1, t_.end(), t) - t_.begin() - 1;
+    return evaluate(k, t);
+  }
+
+  /// With the segment of the last query in hint, updated to the segment of t
+  double df(double t, size_t& hint) const
+  {
+    size_t n = t_.size(), k = hint < n ? hint : 0;
+    if (t < t_[k])
+      k = std::upper_bound(t_.begin() + 1, t_.begin() + k + 1, t) - t_.begin() - 1;
+    else if (k + 1 < n && t >= t_[k + 1]) {
+      // gallop ahead, then search the last stride
+      size_t step = 1, lo = k + 1;
+      while (lo + step < n && t >= t_[lo + step]) {
+        lo += step;
+        step *= 2;
+      }
+      size_t hi = std::min(n, lo + step);
+      k = std::upper_bound(t_.begin() + lo + 1, t_.begin() + hi, t) - t_.begin() - 1;
+    }
+    hint = k;
+    return evaluate(k, t);
+  }
+
+  /// Batch discount factors, out[i] = df(t[i]), fastest for increasing t
+  void df(span<double const> t, span<double> out) const
+  {
+    assert(t.size() == out.size());
+    size_t hint = 0;
+    for (size_t i = 0; i < t.size(); ++i)
+      out[i] = df(t[i], hint);
+  }
+
+  /// Continuously compounded zero rate to t
+  double zero(double t) const
+  {
+    return t > 0 ? -log(df(t)) / t : scheme_ == Interpolation::LinearZero ? a_[0] : -b_[0];
+  }
+
+  /// Continuously compounded forward rate from t1 to t2
+  double forward(double t1, double t2) const
+  {
+    return log(df(t1) / df(t2)) / (t2 - t1);
+  }
+
+private:
+  double evaluate(size_t k, double t) const
+  {
+    double h = t - t_[k], y = a_[k] + h * (b_[k] + h * (c_[k] + h * d_[k]));
+    return exp(scheme_ == Interpolation::LinearZero ? -y * t : y);
+  }
+
+  /// Fritsch-Butland slopes at the nodes and the Hermite coefficients of each segment
+  void hermite()
+  {
+    size_t n = t_.size();
+    std::vector<double> s(b_.begin(), b_.end() - 1), m(n);
+    m[0] = s[0];
+    m[n - 1] = s[n - 2];
+    for (size_t i = 1; i + 1 < n; ++i) {
+      double h0 = t_[i] - t_[i - 1], h1 = t_[i + 1] - t_[i];
+      m[i] = s[i - 1] * s[i] <= 0 ? 0.0
+           : 3 * (h0 + h1) / ((2 * h1 + h0) / s[i - 1] + (h1 + 2 * h0) / s[i]);
+    }
+    for (size_t i = 0; i + 1 < n; ++i) {
+      double h = t_[i + 1] - t_[i];
+      b_[i] = m[i];
+      c_[i] = (3 * s[i] - 2 * m[i] - m[i + 1]) / h;
+      d_[i] = (m[i] + m[i + 1] - 2 * s[i]) / (h * h);
+    }
+    b_[n - 1] = m[n - 1];
+  }
+
+  Interpolation scheme_;
+  std::vector<double> t_, a_, b_, c_, d_;
+};
+
+/// Present value of the flows on a curve, the discount factors walked with a hint; F is moot
+template <Flow F, typename T, typename U>
+double pv(T const& times, U const& amounts, discount_curve const& curve)
+{
+  double v = 0;
+  size_t hint = 0;
+  auto ti = std::begin(times);
+  auto ci = std::begin(amounts);
+  for (; ti != std::end(times) && ci != std::end(amounts); ++ti, ++ci)
+    v += *ci * curve.df(*ti, hint);
+  return v;
+}
+
+template <Flow F, typename T, typename U>
+double bond_price(T const& times, U const& amounts, discount_curve const& curve)
+{
+  return pv<F>(times, amounts, curve);
+}
+
+/**
+ * Market instrument for bootstrapping: the curve reprices it when error(curve) is zero, and
+ * its maturity is the pillar it determines. Rates are simple for deposits and futures, par
+ * rates with frequency fixed payments a year for swaps, and bonds are flows at a dirty price.
+ **/
+struct instrument
+{
+  enum class Kind { Deposit, Future, Swap, Bond };
+
+  Kind kind;
+  double start, maturity, quote;
+  unsigned frequency;
+  std::vector<double> times, amounts;
+
+  static instrument deposit(double t, double rate)
+  {
+    return instrument{ Kind::Deposit, 0, t, rate, 0, {}, {} };
+  }
+
+  /// Future on the rate from t1 to t2 at price 100 - 100 * rate, no convexity adjustment
+  static instrument future(double t1, double t2, double price)
+  {
+    return instrument{ Kind::Future, t1, t2, price, 0, {}, {} };
+  }
+
+  static instrument swap(double t, double rate, unsigned frequency)
+  {
+    return instrument{ Kind::Swap, 0, t, rate, frequency, {}, {} };
+  }
+
+  template <typename T, typename U>
+  static instrument bond(T const& times, U const& amounts, double price)
+  {
+    instrument b{ Kind::Bond, 0, 0, price, 0,
+                  std::vector<double>(std::begin(times), std::end(times)),
+                  std::vector<double>(std::begin(amounts), std::end(amounts)) };
+    b.maturity = b.times.back();
+    return b;
+  }
+
+  double error(discount_curve const& c) const
+  {
+    switch (kind) {
+    case Kind::Deposit:
+      return c.df(maturity) * (1 + quote * maturity) - 1;
+    case Kind::Future:
+      return c.df(maturity) * (1 + (1 - quote / 100) * (maturity - start)) - c.df(start);
+    case Kind::Swap: {
+      size_t n = size_t(std::round(maturity * frequency));
+      double annuity = 0;
+      size_t hint = 0;
+      for (size_t k = 1; k <= n; ++k)
+        annuity += c.df(double(k) / frequency, hint);
+      return quote * annuity / frequency + c.df(maturity) - 1;
+    }
+    default:
+      return pv<Flow::Continuous>(times, amounts, c) / quote - 1;
+    }
+  }
+};
+
+/**
+ * Curve through the instruments, one pillar at each maturity. Pillars are solved in maturity
+ * order by Brent on the zero rate of the new pillar with the earlier ones fixed. The
+ * monotone cubic couples a pillar to its neighbours, so its sweep is repeated until no
+ * pillar moves. When no zero rate in [-50%, 200%] reprices an instrument, its pillar and the
+ * later ones, bootstrapped on top of it, are NaN.
+ **/
+inline discount_curve bootstrap(std::vector<instrument> instruments,
+                                Interpolation scheme = Interpolation::LogLinearDiscount)
+{
+  assert(!instruments.empty());
+  std::sort(instruments.begin(), instruments.end(),
+            [](instrument const& a, instrument const& b) { return a.maturity < b.maturity; });
+  size_t n = instruments.size();
+  std::vector<double> t(n), df(n);
+  for (size_t i = 0; i < n; ++i) {
+    t[i] = instruments[i].maturity;
+    df[i] = exp(-0.02 * t[i]);
+  }
+  discount_curve curve(t, df, scheme);
+  size_t sweeps = scheme == Interpolation::MonotoneCubic ? 20 : 1;
+  for (size_t s = 0; s < sweeps; ++s) {
+    double moved = 0;
+    for (size_t i = 0; i < n; ++i) {
+      auto f = [&](double z) {
+        df[i] = exp(-z * t[i]);
+        curve.reset(t, df);
+        return instruments[i].error(curve);
+      };
+      double before = df[i];
+      if (!(std::abs(f(solver::brent(f, std::make_pair(-0.5, 2.0), 1e-15).first)) < 1e-10)) {
+        std::fill(df.begin() + i, df.end(), std::numeric_limits<double>::quiet_NaN());
+        curve.reset(t, df);
+        return curve;
+      }
+      moved = std::max(moved, std::abs(df[i] - before));
+    }
+    if (moved < 1e-15)
+      break;
+  }
+  return curve;
+}
+
+} // namespace sfinx
@@ -0,0 +1,208 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include "math.hpp"
+
+namespace sfinx { namespace ad {
+
+/**
+ * Forward mode dual number, the value and its first derivatives along n directions. The pricing
+ * templates run on it unchanged as Num, seeding a parameter with dual(x, k) gives its
+ * sensitivity in d[k]. Comparisons look at the value only. The functions live in sfinx::ad so
+ * that they do not hide the <cmath> ones from unqualified calls on double in sfinx.
+ **/
+template <size_t n>
+struct dual
+{
+  double v;
+  double d[n];
+
+  dual(double x = 0) : v(x)
+  {
+    for (size_t k = 0; k < n; ++k)
+      d[k] = 0;
+  }
+
+  dual(double x, size_t k) : dual(x)
+  {
+    d[k] = 1;
+  }
+};
+
+namespace aux {
+/// Chain rule, value f and derivative df of the outer function at x.v
+template <size_t n>
+inline dual<n> chain(dual<n> const& x, double f, double df)
+{
+  dual<n> y(f);
+  for (size_t k = 0; k < n; ++k)
+    y.d[k] = df * x.d[k];
+  return y;
+}
+} // namespace sfinx::ad::aux
+
+template <size_t n>
+inline dual<n> operator-(dual<n> const& x)
+{
+  return aux::chain(x, -x.v, -1);
+}
+
+template <size_t n>
+inline dual<n> operator+(dual<n> const& x, dual<n> const& y)
+{
+  dual<n> z(x.v + y.v);
+  for (size_t k = 0; k < n; ++k)
+    z.d[k] = x.d[k] + y.d[k];
+  return z;
+}
+
+template <size_t n>
+inline dual<n> operator-(dual<n> const& x, dual<n> const& y)
+{
+  dual<n> z(x.v - y.v);
+  for (size_t k = 0; k < n; ++k)
+    z.d[k] = x.d[k] - y.d[k];
+  return z;
+}
+
+template <size_t n>
+inline dual<n> operator*(dual<n> const& x, dual<n> const& y)
+{
+  dual<n> z(x.v * y.v);
+  for (size_t k = 0; k < n; ++k)
+    z.d[k] = x.d[k] * y.v + x.v * y.d[k];
+  return z;
+}
+
+template <size_t n>
+inline dual<n> operator/(dual<n> const& x, dual<n> const& y)
+{
+  dual<n> z(x.v / y.v);
+  for (size_t k = 0; k < n; ++k)
+    z.d[k] = (x.d[k] - z.v * y.d[k]) / y.v;
+  return z;
+}
+
+template <size_t n>
+inline dual<n> operator+(dual<n> const& x, double y)
+{
+  return aux::chain(x, x.v + y, 1);
+}
+
+template <size_t n>
+inline dual<n> operator+(double x, dual<n> const& y)
+{
+  return y + x;
+}
+
+template <size_t n>
+inline dual<n> operator-(dual<n> const& x, double y)
+{
+  return aux::chain(x, x.v - y, 1);
+}
+
+template <size_t n>
+inline dual<n> operator-(double x, dual<n> const& y)
+{
+  return aux::chain(y, x - y.v, -1);
+}
+
+template <size_t n>
+inline dual<n> operator*(dual<n> const& x, double y)
+{
+  return aux::chain(x, x.v * y, y);
+}
+
+template <size_t n>
+inline dual<n> operator*(double x, dual<n> const& y)
+{
+  return y * x;
+}
+
+template <size_t n>
+inline dual<n> operator/(dual<n> const& x, double y)
+{
+  return aux::chain(x, x.v / y, 1 / y);
+}
+
+template <size_t n>
+inline dual<n> operator/(double x, dual<n> const& y)
+{
+  return aux::chain(y, x / y.v, -x / (y.v * y.v));
+}
+
+#define SFINX_DUAL_COMPARE(op) \
+  template <size_t n> \
+  inline bool operator op(dual<n> const& x, dual<n> const& y) { return x.v op y.v; } \
+  template <size_t n> \
+  inline bool operator op(dual<n> const& x, double y) { return x.v op y; } \
+  template <size_t n> \
+  inline bool operator op(double x, dual<n> const& y) { return x op y.v; }
+SFINX_DUAL_COMPARE(<)
+SFINX_DUAL_COMPARE(>)
+SFINX_DUAL_COMPARE(<=)
+SFINX_DUAL_COMPARE(>=)
+SFINX_DUAL_COMPARE(==)
+SFINX_DUAL_COMPARE(!=)
+#undef SFINX_DUAL_COMPARE
+
+template <size_t n>
+inline dual<n> exp(dual<n> const& x)
+{
+  double e = std::exp(x.v);
+  return aux::chain(x, e, e);
+}
+
+template <size_t n>
+inline dual<n> log(dual<n> const& x)
+{
+  return aux::chain(x, std::log(x.v), 1 / x.v);
+}
+
+template <size_t n>
+inline dual<n> sqrt(dual<n> const& x)
+{
+  double s = std::sqrt(x.v);
+  return aux::chain(x, s, 0.5 / s);
+}
+
+template <size_t n>
+inline dual<n> pow(dual<n> const& x, double y)
+{
+  double p = std::pow(x.v, y);
+  return aux::chain(x, p, y * p / x.v);
+}
+
+template <size_t n>
+inline dual<n> pow(dual<n> const& x, dual<n> const& y)
+{
+  return exp(y * log(x));
+}
+
+/// The tiers of the normal distribution, the derivative of every cdf tier is the exact density
+template <size_t n>
+inline dual<n> exact_cdf(dual<n> const& x)
+{
+  return aux::chain(x, normal::exact_cdf(x.v), normal::exact_pdf(x.v));
+}
+
+template <size_t n>
+inline dual<n> rational_cdf(dual<n> const& x)
+{
+  return aux::chain(x, normal::rational_cdf(x.v), normal::exact_pdf(x.v));
+}
+
+template <size_t n>
+inline dual<n> fast_cdf(dual<n> const& x)
+{
+  return aux::chain(x, normal::fast_cdf(x.v), normal::exact_pdf(x.v));
+}
+
+template <size_t n>
+inline dual<n> exact_pdf(dual<n> const& x)
+{
+  double p = normal::exact_pdf(x.v);
+  return aux::chain(x, p, -x.v * p);
+}
+
+} } // namespace sfinx::ad
@@ -0,0 +1,184 @@
+#pragma once
+#include <cmath>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include "math.hpp"
+#include "span.hpp"
+#include "simd.hpp"
+#include "black_scholes.hpp"
+
+namespace sfinx {
+
+namespace iv {
+
+enum class Status : unsigned char
+{
+  Converged,
+  BelowIntrinsic,   // price at or below the intrinsic value, no volatility reproduces it
+  AboveBound,       // price at or above the forward (call) or strike (put) bound
+  MaxIterations
+};
+
+template <typename Num>
+struct result
+{
+  Num vol;
+  unsigned iterations;
+  Status status;
+};
+
+namespace aux {
+
+/**
+ * Lockstep solve, Num is double or simd::pack, phi is 1 for a call quote and -1 for a put.
+ * The quote is moved to the out-of-the-money side through parity and solved for the total
+ * volatility s = v * sqrt(T) on log(price), which is close to linear in s even far in the
+ * wings. Start from the Corrado-Miller guess and take Householder steps of order 3 with the
+ * analytic vega and its two derivatives, keeping a bracket [lo, hi] and bisecting when a step
+ * leaves it. A lane stops once its step is below eps * s.
+ * status is the Status code as a Num, vol is NaN for lanes that fail the no-arbitrage bounds.
+ **/
+template <typename Num>
+void solve(Num phi, Num price, Num S, Num X, Num T, Num r, Num b, Num eps, size_t maxIter,
+           Num& vol, Num& iterations, Num& status)
+{
+  typedef decltype(Num() < Num()) Mask;
+  Num const inf = std::numeric_limits<double>::infinity();
+  Num F = S * exp(b * T), c = price * exp(r * T);
+  Num otm = simd::select(X < F, Num(-1.0), Num(1.0));
+  c = simd::select(phi == otm, c, c - phi * (F - X));
+  Num x = log(F / X), target = log(c);
+  Mask above = c > 0.0;
+  Mask below = c < simd::min(F, X);
+  Mask active = above & below;
+
+  Num m = c - otm * (F - X) / 2, a = simd::abs(F - X);
+  Num s = 2.5066282746310002 / (F + X) * (m + sqrt(simd::max(m * m - a * a / Pi, 0.0)));
+  s = simd::select(s > 1.0e-3, s, sqrt(2 * simd::abs(x)));
+  s = simd::min(simd::max(s, 1.0e-3), 5.0);
+
+  Num lo = 0.0, hi = inf, iter = 0.0;
+  for (size_t k = 0; k < maxIter && simd::any(active); ++k) {
+    Num d1 = x / s + s / 2, d2 = d1 - s;
+    Num model = otm * (F * normal_cdf(otm * d1) - X * normal_cdf(otm * d2));
+    Num f = log(model) - target;
+    lo = simd::select(f < 0.0, s, lo);
+    hi = simd::select(f > 0.0, s, hi);
+
+    // Derivatives of log(model) from vega / model and those of the price
+    Num g = F * normal_pdf(d1) / model, dd = d1 * d2;
+    Num nu2 = dd / s, nu3 = (dd * dd - d1 * d1 - d2 * d2 - dd) / (s * s);
+    nu3 = nu3 - 3 * g * nu2 + 2 * g * g;
+    nu2 = nu2 - g;
+    Num h = f / g;
+    Num sn = s - h * (1 - h * nu2 / 2) / (1 - h * nu2 + h * h * nu3 / 6);
+    Mask done = simd::abs(sn - s) <= eps * s;
+    Mask inside = done | ((sn > lo) & (sn < hi));
+    sn = simd::select(inside, sn, simd::select(hi < inf, (lo + hi) / 2, 2 * s));
+
+    s = simd::select(active, sn, s);
+    iter = simd::select(active, iter + 1.0, iter);
+    active = active & !done;
+  }
+
+  vol = simd::select(above & below, s / sqrt(T), std::numeric_limits<double>::quiet_NaN());
+  iterations = iter;
+  status = simd::select(above & below,
+                        simd::select(active, Num(double(Status::MaxIterations)),
+                                     Num(double(Status::Converged))),
+                        simd::select(above, Num(double(Status::AboveBound)),
+                                     Num(double(Status::BelowIntrinsic))));
+}
+
+template <option::Type type>
+void solve(span<double const> price, span<double const> S, span<double const> X,
+           span<double const> T, span<double const> r, span<double const> b, double eps,
+           size_t maxIter, span<double> vol, span<unsigned> iterations, span<Status> status)
+{
+  size_t n = price.size();
+  assert(S.size() == n && X.size() == n && T.size() == n && r.size() == n && b.size() == n
+         && vol.size() == n && iterations.size() == n && status.size() == n);
+  double it[simd::pack::size], st[simd::pack::size];
+  for (size_t i = 0; i < n; i += simd::pack::size) {
+    simd::pack v, its, sts;
+    solve(simd::pack(type == option::Type::Call ? 1.0 : -1.0), simd::load(price, i),
+          simd::load(S, i), simd::load(X, i), simd::load(T, i), simd::load(r, i),
+          simd::load(b, i), simd::pack(eps), maxIter, v, its, sts);
+    simd::store(vol, i, v);
+    its.store(it);
+    sts.store(st);
+    for (size_t k = 0; k < simd::pack::size && i + k < n; ++k) {
+      iterations[i + k] = unsigned(it[k]);
+      status[i + k] = Status(unsigned(st[k]));
+    }
+  }
+}
+
+template <option::Type type, typename Num>
+result<Num> solve(Num price, Num S, Num X, Num T, Num r, Num b, Num eps, size_t maxIter)
+{
+  static_assert(type != option::Type::Both, "implied volatility needs a call or a put price");
+  Num vol, iterations, status;
+  solve(Num(type == option::Type::Call ? 1 : -1), price, S, X, T, r, b, eps, maxIter,
+        vol, iterations, status);
+  result<Num> res = { vol, unsigned(iterations), Status(unsigned(status)) };
+  return res;
+}
+
+} // namespace sfinx::iv::aux
+} // namespace sfinx::iv
+
+namespace bsm_general {
+
+/**
+ * Implied volatility of a generalized Black-Scholes-Merton price
+ **/
+template <option::Type type, typename Num>
+iv::result<Num> implied_vol(Num price, Num S, Num X, Num T, Num r, Num b,
+                            Num eps = 1.0e-12, size_t maxIter = 16)
+{
+  return iv::aux::solve<type>(price, S, X, T, r, b, eps, maxIter);
+}
+
+/**
+ * Batch implied volatility, the quotes are solved in lockstep over simd::pack lanes and a
+ * lane is masked out as soon as it converges
+ **/
+template <option::Type type>
+void implied_vol(span<double const> price, span<double const> S, span<double const> X,
+                 span<double const> T, span<double const> r, span<double const> b,
+                 span<double> vol, span<unsigned> iterations, span<iv::Status> status,
+                 double eps = 1.0e-12, size_t maxIter = 16)
+{
+  iv::aux::solve<type>(price, S, X, T, r, b, eps, maxIter, vol, iterations, status);
+}
+
+} // namespace sfinx::bsm_general
+
+namespace bs {
+
+/**
+ * Implied volatility of a Black-Scholes price
+ **/
+template <option::Type type, typename Num>
+iv::result<Num> implied_vol(Num price, Num S, Num X, Num T, Num r,
+                            Num eps = 1.0e-12, size_t maxIter = 16)
+{
+  return iv::aux::solve<type>(price, S, X, T, r, r, eps, maxIter);
+}
+
+template <option::Type type>
+void implied_vol(span<double const> price, span<double const> S, span<double const> X,
+                 span<double const> T, span<double const> r,
+                 span<double> vol, span<unsigned> iterations, span<iv::Status> status,
+                 double eps = 1.0e-12, size_t maxIter = 16)
+{
+  iv::aux::solve<type>(price, S, X, T, r, r, eps, maxIter, vol, iterations, status);
+}
+
+} // namespace sfinx::bs
+
+} // namespace sfinx
+
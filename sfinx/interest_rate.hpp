@@ -1,5 +1,12 @@
 #pragma once
+#include <cassert>
 #include <cmath>
+#include <cstddef>
+#include <vector>
+#include "math.hpp"
+#include "span.hpp"
+#include "simd.hpp"
+#include "thread_pool.hpp"
 
 namespace sfinx {
 namespace interest_rate {
@@ -19,7 +26,7 @@ Decimal vasicek(Decimal t, Decimal r0, Decimal a, Decimal b, Decimal sigma)
     A = exp(((B - t) * (a2 * b - sigma2 / 2)) / a2 - ((sigma2 * B * B) / (4 * a)));
   } else {
     B = t;
-    A = exp(sigma2 * pow(t, 3)) / 6;
+    A = exp(sigma2 * pow(t, 3) / 6);
   }
   return A * exp(-B * r0);
 }
@@ -34,15 +41,237 @@ Decimal ho_lee(Decimal t, Decimal delta, Decimal theta)
   return 1 / theta + (1 - theta) * pow(delta, t);
 }
 
+/**
+ * Cox-Ingersoll-Ross model
+ * d(rt) = a(b - rt)dt + sigma * sqrt(rt) * dWt
+ *
+ * P = A exp(-B r0), with h = sqrt(a^2 + 2 sigma^2) and E = exp(h t)
+ *   B = 2 (E - 1) / (2h + (a + h)(E - 1)),  A = (2h exp((a + h) t / 2) / (2h + (a + h)(E - 1)))^(2ab / sigma^2)
+ **/
 template <typename Decimal>
-Decimal hull_white()
+Decimal cox_ingersoll_ross(Decimal t, Decimal r0, Decimal a, Decimal b, Decimal sigma)
 {
+  Decimal h = sqrt(a * a + 2 * sigma * sigma), E1 = expm1(h * t);
+  Decimal den = 2 * h + (a + h) * E1;
+  Decimal B = 2 * E1 / den;
+  Decimal lnA = 2 * a * b / (sigma * sigma) * (log(2 * h / den) + (a + h) * t / 2);
+  return exp(lnA - B * r0);
 }
 
-template <typename Decimal>
-Decimal cox_ingersoll_ross()
+namespace aux {
+
+/// Instantaneous forward rate of the curve at t, second order differences of ln df
+template <typename Curve>
+double forward(Curve const& curve, double t)
 {
+  double const h = 1.0e-5;
+  if (t >= h)
+    return log(curve.df(t - h) / curve.df(t + h)) / (2 * h);
+  return (3 * log(curve.df(t)) - 4 * log(curve.df(t + h)) + log(curve.df(t + 2 * h))) / (2 * h);
 }
 
-} } // namespace sfinx::interest_rate
+} // namespace sfinx::interest_rate::aux
+
+/**
+ * Hull-White model fitted to the initial curve, curve.df(T) = P(0, T)
+ * d(rt) = (theta(t) - a rt)dt + sigma * dWt
+ *
+ * Price at t of the zero coupon bond maturing at T with the short rate at r,
+ *   P(t, T) = P(0, T) / P(0, t) exp(B f(0, t) - sigma^2 / (4a) (1 - exp(-2at)) B^2 - B r),
+ * B = (1 - exp(-a (T - t))) / a and f(0, t) the instantaneous forward of the curve.
+ **/
+template <typename Curve>
+double hull_white(Curve const& curve, double t, double T, double r, double a, double sigma)
+{
+  double tau = T - t, B = a == 0 ? tau : -expm1(-a * tau) / a;
+  double v = a == 0 ? sigma * sigma * t / 2 : -sigma * sigma * expm1(-2 * a * t) / (4 * a);
+  return curve.df(T) / curve.df(t) * exp(B * (aux::forward(curve, t) - r) - v * B * B);
+}
+
+struct short_rate_params
+{
+  double r0, a, b, sigma;
+};
+
+struct hull_white_params
+{
+  double a, sigma;
+};
+
+namespace aux {
+
+/// Row k of out from price(T) over the packs of maturities
+template <typename Price>
+void tabulate(span<double const> T, size_t k, span<double> out, Price const& price)
+{
+  size_t const m = T.size();
+  span<double> row = out.subspan(k * m, m);
+  for (size_t i = 0; i < m; i += simd::pack::size)
+    simd::store(row, i, price(simd::load(T, i, 0.0), i));
+}
 
+} // namespace sfinx::interest_rate::aux
+
+/**
+ * vasicek zero coupon prices of every parameter set at every maturity, row k of out for p[k].
+ * One exp for B and one for the price per point, parameter sets spread over the pool.
+ **/
+inline void vasicek(span<double const> T, span<short_rate_params const> p, span<double> out,
+                    thread_pool& pool)
+{
+  assert(out.size() == T.size() * p.size());
+  pool.parallel_for(p.size(), [&](size_t k) {
+    short_rate_params const q = p[k];
+    simd::pack r0(q.r0), s2(q.sigma * q.sigma);
+    if (q.a == 0) {
+      aux::tabulate(T, k, out, [&](simd::pack t, size_t) {
+        return simd::exp(s2 * t * t * t / 6 - t * r0);
+      });
+      return;
+    }
+    simd::pack a(q.a), inv(1 / q.a), c(q.b - q.sigma * q.sigma / (2 * q.a * q.a));
+    simd::pack d(q.sigma * q.sigma / (4 * q.a));
+    aux::tabulate(T, k, out, [&](simd::pack t, size_t) {
+      simd::pack B = (1 - simd::exp(-a * t)) * inv;
+      return simd::exp((B - t) * c - d * B * B - B * r0);
+    });
+  });
+}
+
+/// cox_ingersoll_ross at every maturity, exp(h t) shared by A and B, one log and one exp more
+inline void cox_ingersoll_ross(span<double const> T, span<short_rate_params const> p,
+                               span<double> out, thread_pool& pool)
+{
+  assert(out.size() == T.size() * p.size());
+  pool.parallel_for(p.size(), [&](size_t k) {
+    short_rate_params const q = p[k];
+    double h = sqrt(q.a * q.a + 2 * q.sigma * q.sigma);
+    simd::pack hp(h), ah(q.a + h), h2(2 * h), r0(q.r0), c(2 * q.a * q.b / (q.sigma * q.sigma));
+    simd::pack ln2h(log(2 * h));
+    aux::tabulate(T, k, out, [&](simd::pack t, size_t) {
+      simd::pack E1 = simd::exp(hp * t) - 1, den = h2 + ah * E1;
+      return simd::exp(c * (ln2h - simd::log(den) + ah * t / 2) - 2 * E1 / den * r0);
+    });
+  });
+}
+
+/**
+ * hull_white prices at t with the short rate at r for every parameter set at every maturity.
+ * The curve is read once, at t and at the maturities, for all parameter sets.
+ **/
+template <typename Curve>
+void hull_white(Curve const& curve, double t, double r, span<double const> T,
+                span<hull_white_params const> p, span<double> out, thread_pool& pool)
+{
+  assert(out.size() == T.size() * p.size());
+  std::vector<double> ratio(T.size());
+  double dft = curve.df(t), f = aux::forward(curve, t);
+  for (size_t i = 0; i < T.size(); ++i)
+    ratio[i] = curve.df(T[i]) / dft;
+  span<double const> P = ratio;
+  pool.parallel_for(p.size(), [&](size_t k) {
+    hull_white_params const q = p[k];
+    double v = q.a == 0 ? q.sigma * q.sigma * t / 2
+                        : -q.sigma * q.sigma * std::expm1(-2 * q.a * t) / (4 * q.a);
+    simd::pack a(q.a), inv(q.a == 0 ? 0 : 1 / q.a), vp(v), fr(f - r), tp(t);
+    aux::tabulate(T, k, out, [&](simd::pack Ti, size_t i) {
+      simd::pack tau = Ti - tp;
+      simd::pack B = q.a == 0 ? tau : (1 - simd::exp(-a * tau)) * inv;
+      return simd::load(P, i) * simd::exp(B * fr - vp * B * B);
+    });
+  });
+}
+
+/// On the calling thread
+inline void vasicek(span<double const> T, span<short_rate_params const> p, span<double> out)
+{
+  thread_pool inline_pool(1);
+  vasicek(T, p, out, inline_pool);
+}
+
+inline void cox_ingersoll_ross(span<double const> T, span<short_rate_params const> p,
+                               span<double> out)
+{
+  thread_pool inline_pool(1);
+  cox_ingersoll_ross(T, p, out, inline_pool);
+}
+
+template <typename Curve>
+void hull_white(Curve const& curve, double t, double r, span<double const> T,
+                span<hull_white_params const> p, span<double> out)
+{
+  thread_pool inline_pool(1);
+  hull_white(curve, t, r, T, p, out, inline_pool);
+}
+
+namespace aux {
+
+/// Volatility of ln P(T, S) at T in the Gaussian models, Vasicek and Hull-White
+inline double bond_vol(double T, double S, double a, double sigma)
+{
+  if (a == 0)
+    return sigma * (S - T) * sqrt(T);
+  return sigma * -std::expm1(-a * (S - T)) / a * sqrt(-std::expm1(-2 * a * T) / (2 * a));
+}
+
+} // namespace sfinx::interest_rate::aux
+
+/**
+ * Call at 0, expiring at T, on the zero coupon bond maturing at S > T with strike X, in the
+ * Vasicek or the Hull-White model of mean reversion a and volatility sigma. PT and PS are the
+ * model prices at 0 of the bonds to T and S: vasicek for Vasicek, the initial curve for
+ * Hull-White.
+ **/
+inline double bond_call(double PT, double PS, double X, double T, double S, double a, double sigma)
+{
+  double v = aux::bond_vol(T, S, a, sigma), h = log(PS / (X * PT)) / v + v / 2;
+  return PS * normal_cdf(h) - X * PT * normal_cdf(h - v);
+}
+
+inline double bond_put(double PT, double PS, double X, double T, double S, double a, double sigma)
+{
+  double v = aux::bond_vol(T, S, a, sigma), h = log(PS / (X * PT)) / v + v / 2;
+  return X * PT * normal_cdf(v - h) - PS * normal_cdf(-h);
+}
+
+/**
+ * Caplet and floorlet of notional 1 on the simple rate from T to S, paid at S with strike K:
+ * 1 + K (S - T) puts, or calls for the floorlet, on P(T, S) struck at 1 / (1 + K (S - T)).
+ **/
+inline double caplet(double PT, double PS, double K, double T, double S, double a, double sigma)
+{
+  double m = 1 + K * (S - T);
+  return m * bond_put(PT, PS, 1 / m, T, S, a, sigma);
+}
+
+inline double floorlet(double PT, double PS, double K, double T, double S, double a, double sigma)
+{
+  double m = 1 + K * (S - T);
+  return m * bond_call(PT, PS, 1 / m, T, S, a, sigma);
+}
+
+/**
+ * Cap and floor on the periods [t_i, t_i+1) of times, t_0 > 0 the first fixing, df the model
+ * bond prices at the times
+ **/
+inline double cap(span<double const> times, span<double const> df, double K, double a,
+                  double sigma)
+{
+  assert(times.size() == df.size());
+  double v = 0;
+  for (size_t i = 0; i + 1 < times.size(); ++i)
+    v += caplet(df[i], df[i + 1], K, times[i], times[i + 1], a, sigma);
+  return v;
+}
+
+inline double floor(span<double const> times, span<double const> df, double K, double a,
+                    double sigma)
+{
+  assert(times.size() == df.size());
+  double v = 0;
+  for (size_t i = 0; i + 1 < times.size(); ++i)
+    v += floorlet(df[i], df[i + 1], K, times[i], times[i + 1], a, sigma);
+  return v;
+}
+
+} } // namespace sfinx::interest_rate
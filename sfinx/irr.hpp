@@ -1,22 +1,44 @@
 #pragma once
-#include <functional>
+#include <cmath>
+#include <tuple>
 #include <limits>
 #include "pv.hpp"
 #include "solver.hpp"
 
 namespace sfinx {
 
+namespace aux {
+
+/// The rate at which the flows are worth price at time 0
 template <Flow F, typename T, typename U>
-double irr(T const& times, U const& amounts)
+double solve_yield(T const& times, U const& amounts, double price, solver::trace* tr)
 {
-  using namespace std::placeholders;
-  auto range = std::make_pair(0.0, 1.0);
-  double eps = 1.0e-5;
-  auto f = [&](double r){ return pv<F>(times, amounts, r); };
-  auto res = solver::bisection(f, range, eps);
-  return res.second <= eps ? res.first : std::numeric_limits<double>::quiet_NaN();
+  double eps = 1.0e-12, inf = std::numeric_limits<double>::infinity();
+  auto range = std::make_pair(F == Flow::Discrete ? -1.0 : -inf, inf);
+  auto f = [&](double r) {
+    auto s = pv_derivatives<F>(times, amounts, r);
+    return std::make_tuple(s.pv - price, s.dpv, s.d2pv);
+  };
+  size_t maxIter = 100;
+  solver::trace t;
+  auto res = solver::halley(f, yield_guess<F>(times, amounts, price), range, eps, maxIter, &t);
+  if (tr)
+    *tr = t;
+  return t.iterations < maxIter ? res.first : std::numeric_limits<double>::quiet_NaN();
 }
 
+} // namespace sfinx::aux
+
+/**
+ * Internal rate of return by safeguarded Halley iteration on pv and its derivatives from one
+ * walk each, started from aux::yield_guess. Negative rates are allowed, down to -1 for Discrete.
+ * NaN when no root is found, tr reports the work done.
+ **/
+template <Flow F, typename T, typename U>
+double irr(T const& times, U const& amounts, solver::trace* tr = nullptr)
+{
+  return aux::solve_yield<F>(times, amounts, 0.0, tr);
+}
 
 } // namespace sfinx
 
@@ -0,0 +1,225 @@
+#pragma once
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#include "math.hpp"
+#include "span.hpp"
+#include "simd.hpp"
+#include "black_scholes.hpp"
+
+namespace sfinx { namespace lattice {
+
+enum class Method
+{
+  CRR,            // Cox-Ross-Rubinstein binomial
+  LeisenReimer,   // Leisen-Reimer binomial, Peizer-Pratt inversion, rounds steps up to odd
+  Trinomial       // Boyle trinomial, u = exp(v sqrt(2 dt))
+};
+
+/// Value with delta, gamma and theta read off the first levels of the tree, theta is per year
+template <typename Num>
+struct result
+{
+  Num value, delta, gamma, theta;
+};
+
+namespace aux {
+
+/// One time step, pu, pm and pd are the discounted branch probabilities
+struct step
+{
+  size_t steps;
+  double dt, u, d, pu, pm, pd;
+};
+
+inline step crr(double T, double r, double b, double v, size_t n)
+{
+  double dt = T / n, u = exp(v * sqrt(dt)), d = 1 / u, df = exp(-r * dt);
+  double p = (exp(b * dt) - d) / (u - d);
+  step s = { n, dt, u, d, p * df, 0, (1 - p) * df };
+  return s;
+}
+
+/// Peizer-Pratt method 2 inversion, the probability that n binomial steps end above z
+inline double peizer_pratt(double z, double n)
+{
+  double t = z / (n + 1.0 / 3 + 0.1 / (n + 1));
+  return 0.5 + std::copysign(0.5, z) * sqrt(1 - exp(-t * t * (n + 1.0 / 6)));
+}
+
+inline step leisen_reimer(double S, double X, double T, double r, double b, double v, size_t n)
+{
+  n += 1 - n % 2;
+  double d1 = bsm_general::d1(S, X, T, b, v), d2 = bsm_general::d2(d1, T, v);
+  double dt = T / n, p = peizer_pratt(d2, n), eb = exp(b * dt), df = exp(-r * dt);
+  double u = eb * peizer_pratt(d1, n) / p, d = (eb - p * u) / (1 - p);
+  step s = { n, dt, u, d, p * df, 0, (1 - p) * df };
+  return s;
+}
+
+inline step trinomial(double T, double r, double b, double v, size_t n)
+{
+  double dt = T / n, u = exp(v * sqrt(2 * dt)), a = exp(v * sqrt(dt / 2));
+  double eb = exp(b * dt / 2), df = exp(-r * dt);
+  double pu = (eb - 1 / a) / (a - 1 / a), pd = (a - eb) / (a - 1 / a);
+  pu *= pu;
+  pd *= pd;
+  step s = { n, dt, u, 1 / u, pu * df, (1 - pu - pd) * df, pd * df };
+  return s;
+}
+
+template <Method method>
+step make(double S, double X, double T, double r, double b, double v, size_t n)
+{
+  return method == Method::CRR ? crr(T, r, b, v, n)
+       : method == Method::LeisenReimer ? leisen_reimer(S, X, T, r, b, v, n)
+       : trinomial(T, r, b, v, n);
+}
+
+/**
+ * Greeks from the node values top[j][i] of levels j = 0, 1, 2. Node i of level j is at price
+ * S u^i d^(j - i) on a binomial tree and at S u^i d^j on a trinomial one.
+ **/
+template <Method method>
+result<double> greeks(step const& s, double S, double const (&top)[3][5])
+{
+  double u = s.u, d = s.d;
+  result<double> g;
+  g.value = top[0][0];
+  if (method == Method::Trinomial) {
+    double Su = S * u, Sd = S * d;
+    g.delta = (top[1][2] - top[1][0]) / (Su - Sd);
+    g.gamma = ((top[1][2] - top[1][1]) / (Su - S) - (top[1][1] - top[1][0]) / (S - Sd))
+        / ((Su - Sd) / 2);
+    g.theta = (top[1][1] - top[0][0]) / s.dt;
+  } else {
+    double Suu = S * u * u, Sud = S * u * d, Sdd = S * d * d;
+    g.delta = (top[1][1] - top[1][0]) / (S * u - S * d);
+    g.gamma = ((top[2][2] - top[2][1]) / (Suu - Sud) - (top[2][1] - top[2][0]) / (Sud - Sdd))
+        / ((Suu - Sdd) / 2);
+    // The middle node is at S u d, which is S only on a recombining CRR tree
+    double dS = Sud - S, V = top[2][1] - g.delta * dS - g.gamma * dS * dS / 2;
+    g.theta = (V - top[0][0]) / (2 * s.dt);
+  }
+  return g;
+}
+
+} // namespace sfinx::lattice::aux
+
+/**
+ * Vanilla option on a tree of the given method with steps time steps. The backward induction
+ * runs in place over one array of node values, a pack of nodes at a time, with the asset
+ * prices of the level carried along in a second array for the early exercise test.
+ **/
+template <option::Type type, option::Exercise exercise = option::Exercise::American,
+          Method method = Method::CRR>
+result<double> value(double S, double X, double T, double r, double b, double v, size_t steps)
+{
+  static_assert(type != option::Type::Both, "a call or a put");
+  bool const american = exercise == option::Exercise::American;
+  size_t const w = method == Method::Trinomial ? 2 : 1, W = simd::pack::size;
+  aux::step s = aux::make<method>(S, X, T, r, b, v, steps);
+  size_t n = s.steps;
+  std::vector<double> V(w * n + 1 + W + w, 0.0), P(V.size(), 0.0);
+
+  double phi = type == option::Type::Call ? 1 : -1, lu = log(s.u), ld = log(s.d);
+  for (size_t i = 0; i <= w * n; ++i) {
+    P[i] = S * exp(i * lu + (w == 2 ? n : n - i) * ld);
+    V[i] = std::max(phi * (P[i] - X), 0.0);
+  }
+
+  double top[3][5] = {};
+  simd::pack pu(s.pu), pm(s.pm), pd(s.pd), invd(1 / s.d), phi_(phi), X_(X);
+  for (size_t j = n; j-- > 0;) {
+    size_t m = w * j + 1;
+    for (size_t i = 0; i < m; i += W) {
+      simd::pack c = pd * simd::pack::load(&V[i]) + pu * simd::pack::load(&V[i + w]);
+      if (w == 2)
+        c = c + pm * simd::pack::load(&V[i + 1]);
+      if (american) {
+        simd::pack p = simd::pack::load(&P[i]) * invd;
+        p.store(&P[i]);
+        c = simd::max(c, phi_ * (p - X_));
+      }
+      c.store(&V[i]);
+    }
+    if (j <= 2)
+      std::copy(V.begin(), V.begin() + m, top[j]);
+  }
+  return aux::greeks<method>(s, S, top);
+}
+
+/**
+ * Batch over strikes on one tree, the node values of all strikes are interleaved so that the
+ * inner loop runs across strikes. delta, gamma and theta of out are filled when not empty.
+ * Leisen-Reimer trees depend on the strike and are built one strike at a time.
+ **/
+template <option::Type type, option::Exercise exercise = option::Exercise::American,
+          Method method = Method::CRR>
+void value(double S, span<double const> X, double T, double r, double b, double v, size_t steps,
+           result<span<double>> const& out)
+{
+  static_assert(type != option::Type::Both, "a call or a put");
+  size_t const k = X.size(), W = simd::pack::size;
+  assert(out.value.size() == k);
+  auto write = [&](size_t i, result<double> const& g) {
+    out.value[i] = g.value;
+    if (!out.delta.empty()) out.delta[i] = g.delta;
+    if (!out.gamma.empty()) out.gamma[i] = g.gamma;
+    if (!out.theta.empty()) out.theta[i] = g.theta;
+  };
+  if (method == Method::LeisenReimer) {
+    for (size_t i = 0; i < k; ++i)
+      write(i, value<type, exercise, method>(S, X[i], T, r, b, v, steps));
+    return;
+  }
+
+  bool const american = exercise == option::Exercise::American;
+  size_t const w = method == Method::Trinomial ? 2 : 1, K = (k + W - 1) / W * W;
+  aux::step s = aux::make<method>(S, S, T, r, b, v, steps);
+  size_t n = s.steps;
+  std::vector<double> Xp(K, X.empty() ? 0.0 : X[k - 1]), V((w * n + 1) * K), P(w * n + 1);
+  std::copy(X.begin(), X.end(), Xp.begin());
+
+  double phi = type == option::Type::Call ? 1 : -1, lu = log(s.u), ld = log(s.d);
+  for (size_t i = 0; i <= w * n; ++i) {
+    P[i] = S * exp(i * lu + (w == 2 ? n : n - i) * ld);
+    for (size_t l = 0; l < K; ++l)
+      V[i * K + l] = std::max(phi * (P[i] - Xp[l]), 0.0);
+  }
+
+  std::vector<double> top(3 * 5 * K);
+  double invd = 1 / s.d;
+  simd::pack pu(s.pu), pm(s.pm), pd(s.pd), phi_(phi);
+  for (size_t j = n; j-- > 0;) {
+    size_t m = w * j + 1;
+    for (size_t i = 0; i < m; ++i) {
+      P[i] *= invd;
+      simd::pack p(P[i]);
+      double* Vi = &V[i * K];
+      for (size_t l = 0; l < K; l += W) {
+        simd::pack c = pd * simd::pack::load(Vi + l) + pu * simd::pack::load(Vi + w * K + l);
+        if (w == 2)
+          c = c + pm * simd::pack::load(Vi + K + l);
+        if (american)
+          c = simd::max(c, phi_ * (p - simd::pack::load(&Xp[l])));
+        c.store(Vi + l);
+      }
+    }
+    if (j <= 2)
+      std::copy(V.begin(), V.begin() + m * K, top.begin() + j * 5 * K);
+  }
+
+  for (size_t l = 0; l < k; ++l) {
+    double t[3][5];
+    for (size_t j = 0; j < 3; ++j)
+      for (size_t i = 0; i < 5; ++i)
+        t[j][i] = top[(j * 5 + i) * K + l];
+    write(l, aux::greeks<method>(s, S, t));
+  }
+}
+
+} } // namespace sfinx::lattice
@@ -0,0 +1,290 @@
+#pragma once
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include "matrix/eigen.hpp"
+#include "math.hpp"
+#include "simd.hpp"
+#include "span.hpp"
+#include "random.hpp"
+#include "thread_pool.hpp"
+#include "monte_carlo.hpp"
+#include "black_scholes.hpp"
+
+namespace sfinx { namespace lsm {
+
+/**
+ * Exercise values on the asset levels S[0, d) at one date. level is the regression variable
+ * the polynomial basis is built on.
+ **/
+template <option::Type t>
+struct vanilla
+{
+  static constexpr option::Type type = t;
+  double X;
+
+  double operator()(double const* S, size_t) const
+  {
+    return std::max((type == option::Type::Call ? 1 : -1) * (S[0] - X), 0.0);
+  }
+
+  double level(double const* S, size_t) const { return S[0]; }
+};
+
+/// Call on the maximum or put on the minimum of the assets
+template <option::Type t>
+struct rainbow
+{
+  static constexpr option::Type type = t;
+  double X;
+
+  double operator()(double const* S, size_t d) const
+  {
+    return std::max((type == option::Type::Call ? 1 : -1) * (level(S, d) - X), 0.0);
+  }
+
+  double level(double const* S, size_t d) const
+  {
+    return type == option::Type::Call ? *std::max_element(S, S + d) : *std::min_element(S, S + d);
+  }
+};
+
+/// Option on the weighted sum of the assets
+template <option::Type t>
+struct basket
+{
+  static constexpr option::Type type = t;
+  double X;
+  span<double const> w;
+
+  double operator()(double const* S, size_t d) const
+  {
+    return std::max((type == option::Type::Call ? 1 : -1) * (level(S, d) - X), 0.0);
+  }
+
+  double level(double const* S, size_t d) const
+  {
+    double x = 0;
+    for (size_t i = 0; i < d; ++i)
+      x += w[i] * S[i];
+    return x;
+  }
+};
+
+/// Regression basis of the powers 0, ..., n - 1 of level / X
+template <int n>
+struct polynomial
+{
+  static constexpr int size = n;
+
+  template <typename Payoff, typename Vector>
+  void operator()(Payoff const& payoff, double const* S, size_t d, Vector& f) const
+  {
+    double x = payoff.level(S, d) / payoff.X, y = 1;
+    for (int k = 0; k < n; ++k, y *= x)
+      f(k) = y;
+  }
+};
+
+/// Constant, the d levels S_i / X, their d (d + 1) / 2 products and the exercise value
+template <int d>
+struct quadratic
+{
+  static constexpr int size = 2 + d + d * (d + 1) / 2;
+
+  template <typename Payoff, typename Vector>
+  void operator()(Payoff const& payoff, double const* S, size_t, Vector& f) const
+  {
+    int k = 0;
+    f(k++) = 1;
+    for (int i = 0; i < d; ++i)
+      f(k++) = S[i] / payoff.X;
+    for (int i = 0; i < d; ++i)
+      for (int j = i; j < d; ++j)
+        f(k++) = S[i] * S[j] / (payoff.X * payoff.X);
+    f(k) = payoff(S, d) / payoff.X;
+  }
+};
+
+struct settings
+{
+  size_t paths = 1 << 15;      // rounded up to whole blocks
+  size_t dates = 50;           // equally spaced exercise dates, the last at expiry
+  uint64_t seed = 0;
+  bool antithetic = true;
+};
+
+typedef decltype(matrix::matrix<double, matrix::dynamic, matrix::dynamic>()) correlation;
+
+namespace aux {
+
+size_t const block = 256, max_assets = 16;
+
+/// Normal equations of one block at one date
+template <int K>
+struct normal_equations
+{
+  decltype(matrix::matrix<double, K, K>()) A;
+  decltype(matrix::matrix<double, K, 1>()) rhs;
+  size_t n;
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/**
+ * Levels of all paths of block j at all dates into S[(t * d + i) * n + p], correlated exact
+ * log normal steps with L the Cholesky factor of the correlation
+ **/
+inline void simulate(size_t j, span<double const> S0, span<double const> b, span<double const> v,
+                     correlation const& L, double dt, settings const& s, size_t n, double* S)
+{
+  size_t const d = S0.size(), W = simd::pack::size, m = s.antithetic ? block / 2 : block;
+  alignas(64) double z[max_assets][block], x[block];
+  for (size_t t = 0; t < s.dates; ++t) {
+    for (size_t i = 0; i < d; ++i) {
+      random::normals(s.seed, uint64_t(j) * m, uint32_t(t * d + i), z[i], m);
+      for (size_t p = m; p < block; ++p)
+        z[i][p] = -z[i][p - m];
+    }
+    for (size_t i = 0; i < d; ++i) {
+      std::fill(x, x + block, 0.0);
+      for (size_t k = 0; k <= i; ++k) {
+        simd::pack l(L(i, k));
+        for (size_t p = 0; p < block; p += W)
+          (simd::pack::load(x + p) + l * simd::pack::load(z[k] + p)).store(x + p);
+      }
+      double* out = S + (t * d + i) * n + j * block;
+      double const* prev = t == 0 ? nullptr : S + ((t - 1) * d + i) * n + j * block;
+      simd::pack drift((b[i] - v[i] * v[i] / 2) * dt), vol(v[i] * sqrt(dt));
+      for (size_t p = 0; p < block; p += W) {
+        simd::pack s0 = prev ? simd::pack::load(prev + p) : simd::pack(S0[i]);
+        (s0 * exp(drift + vol * simd::pack::load(x + p))).store(out + p);
+      }
+    }
+  }
+}
+
+} // namespace sfinx::lsm::aux
+
+/**
+ * Longstaff-Schwartz value of a Bermudan option on d correlated assets under generalized
+ * Black-Scholes-Merton dynamics, exercisable at s.dates equally spaced dates up to T.
+ * American exercise is approached by increasing the dates.
+ *
+ * The continuation value at each date is regressed over the in the money paths on the
+ * fixed size Basis, so the normal equations are Basis::size square Eigen matrices that unroll.
+ * Each block of paths sums its own equations in place, without collecting the in the money
+ * paths, and the sums are reduced in block order and solved by Cholesky. Path generation and
+ * the per date passes run on the pool and the result is the same for any pool size.
+ **/
+template <typename Basis, typename Payoff>
+mc::result value(Payoff const& payoff, span<double const> S0, span<double const> b,
+                 span<double const> v, correlation const& rho, double T, double r,
+                 settings const& s, thread_pool& pool)
+{
+  int const K = Basis::size;
+  typedef decltype(matrix::matrix<double, K, 1>()) vector;
+  typedef aux::normal_equations<K> equations;
+  size_t const d = S0.size(), blocks = (s.paths + aux::block - 1) / aux::block;
+  size_t const n = blocks * aux::block, m = s.antithetic ? aux::block / 2 : aux::block;
+  assert(d > 0 && d <= aux::max_assets && b.size() == d && v.size() == d && s.dates > 0);
+
+  double dt = T / s.dates, df = exp(-r * dt);
+  correlation L = matrix::cholesky(rho);
+  std::vector<double> S(s.dates * d * n), cf(n);
+  pool.parallel_for(blocks, [&](size_t j) {
+    aux::simulate(j, S0, b, v, L, dt, s, n, S.data());
+  });
+
+  auto levels = [&](size_t t, size_t p, double* x) {
+    for (size_t i = 0; i < d; ++i)
+      x[i] = S[(t * d + i) * n + p];
+  };
+  for (size_t p = 0; p < n; ++p) {
+    double x[aux::max_assets] = {};
+    levels(s.dates - 1, p, x);
+    cf[p] = payoff(x, d);
+  }
+
+  Basis basis;
+  std::vector<equations, matrix::aligned_allocator<equations>> eq(blocks);
+  for (size_t t = s.dates - 1; t-- > 0;) {
+    pool.parallel_for(blocks, [&](size_t j) {
+      equations& e = eq[j];
+      e.A.setZero();
+      e.rhs.setZero();
+      e.n = 0;
+      vector f;
+      double x[aux::max_assets] = {};
+      for (size_t p = j * aux::block; p < (j + 1) * aux::block; ++p) {
+        levels(t, p, x);
+        if (payoff(x, d) <= 0)
+          continue;
+        basis(payoff, x, d, f);
+        e.A.noalias() += f * f.transpose();
+        e.rhs.noalias() += f * (df * cf[p]);
+        ++e.n;
+      }
+    });
+    equations total = eq[0];
+    for (size_t j = 1; j < blocks; ++j) {
+      total.A += eq[j].A;
+      total.rhs += eq[j].rhs;
+      total.n += eq[j].n;
+    }
+    bool regress = total.n >= size_t(K);
+    vector beta = regress ? matrix::solve(total.A, total.rhs) : vector(vector::Zero());
+
+    pool.parallel_for(blocks, [&](size_t j) {
+      vector f;
+      double x[aux::max_assets] = {};
+      for (size_t p = j * aux::block; p < (j + 1) * aux::block; ++p) {
+        levels(t, p, x);
+        double h = payoff(x, d);
+        cf[p] *= df;
+        if (regress && h > 0) {
+          basis(payoff, x, d, f);
+          if (h > f.dot(beta))
+            cf[p] = h;
+        }
+      }
+    });
+  }
+
+  double sum = 0, sum2 = 0;
+  for (size_t j = 0; j < blocks; ++j)
+    for (size_t p = j * aux::block; p < j * aux::block + m; ++p) {
+      double y = s.antithetic ? (cf[p] + cf[p + m]) / 2 : cf[p];
+      sum += y;
+      sum2 += y * y;
+    }
+  double N = double(blocks * m), mean = sum / N;
+  mc::result res;
+  res.value = std::max(df * mean, payoff(S0.data(), d));
+  res.error = df * sqrt(std::max(sum2 / N - mean * mean, 0.0) / (N - 1));
+  res.paths = n;
+  return res;
+}
+
+/// Single asset
+template <typename Basis, typename Payoff>
+mc::result value(Payoff const& payoff, double S, double T, double r, double b, double v,
+                 settings const& s, thread_pool& pool)
+{
+  correlation rho = correlation::Identity(1, 1);
+  return value<Basis>(payoff, span<double const>(&S, 1), span<double const>(&b, 1),
+                      span<double const>(&v, 1), rho, T, r, s, pool);
+}
+
+/// Single asset on the calling thread
+template <typename Basis, typename Payoff>
+mc::result value(Payoff const& payoff, double S, double T, double r, double b, double v,
+                 settings const& s)
+{
+  thread_pool inline_pool(1);
+  return value<Basis>(payoff, S, T, r, b, v, s, inline_pool);
+}
+
+} } // namespace sfinx::lsm
@@ -1,7 +1,9 @@
 #pragma once
 #include <cmath>
+#include <algorithm>
 #include <utility>
 #include <numeric>
+#include <functional>
 
 namespace sfinx {
 
@@ -61,7 +63,7 @@ inline double erf(double x)
 }
 */
 
-static double const Pi = 3.141592553589793238462643;
+static double const Pi = 3.14159265358979323846;
 
 inline double normal_cdf(double x)
 {
@@ -70,8 +72,233 @@ inline double normal_cdf(double x)
 
 inline double normal_pdf(double x)
 {
-  return (1.0 / sqrt(2.0 * Pi)) * exp(-0.5 * x * x);
+  return 0.39894228040143267794 * exp(-0.5 * x * x);
 }
 
+namespace aux {
+/**
+ * Rational approximations of Wichura's AS 241 (Applied Statistics 37, 1988), accurate to about
+ * 1e-16. central takes q = p - 0.5 with |q| <= 0.425, near and far take r = sqrt(-log(min(p,
+ * 1 - p))) up to and above 5 and return the magnitude of the quantile. Num is double or
+ * simd::pack.
+ **/
+template <typename Num>
+inline Num as241_central(Num q)
+{
+  Num r = 0.180625 - q * q;
+  return q * (((((((2.5090809287301226727e+3 * r + 3.3430575583588128105e+4) * r
+      + 6.7265770927008700853e+4) * r + 4.5921953931549871457e+4) * r
+      + 1.3731693765509461125e+4) * r + 1.9715909503065514427e+3) * r
+      + 1.3314166789178437745e+2) * r + 3.3871328727963666080e+0)
+    / (((((((5.2264952788528545610e+3 * r + 2.8729085735721942674e+4) * r
+      + 3.9307895800092710610e+4) * r + 2.1213794301586595867e+4) * r
+      + 5.3941960214247511077e+3) * r + 6.8718700749205790830e+2) * r
+      + 4.2313330701600911252e+1) * r + 1.0);
+}
+
+template <typename Num>
+inline Num as241_near(Num r)
+{
+  r = r - 1.6;
+  return (((((((7.74545014278341407640e-4 * r + 2.27238449892691845833e-2) * r
+      + 2.41780725177450611770e-1) * r + 1.27045825245236838258e+0) * r
+      + 3.64784832476320460504e+0) * r + 5.76949722146069140550e+0) * r
+      + 4.63033784615654529590e+0) * r + 1.42343711074968357734e+0)
+    / (((((((1.05075007164441684324e-9 * r + 5.47593808499534494600e-4) * r
+      + 1.51986665636164571966e-2) * r + 1.48103976427480074590e-1) * r
+      + 6.89767334985100004550e-1) * r + 1.67638483018380384940e+0) * r
+      + 2.05319162663775882187e+0) * r + 1.0);
+}
+
+template <typename Num>
+inline Num as241_far(Num r)
+{
+  r = r - 5.0;
+  return (((((((2.01033439929228813265e-7 * r + 2.71155556874348757815e-5) * r
+      + 1.24266094738807843860e-3) * r + 2.65321895265761230930e-2) * r
+      + 2.96560571828504891230e-1) * r + 1.78482653991729133580e+0) * r
+      + 5.46378491116411436990e+0) * r + 6.65790464350110377720e+0)
+    / (((((((2.04426310338993978564e-15 * r + 1.42151175831644588870e-7) * r
+      + 1.84631831751005468180e-5) * r + 7.86869131145613259100e-4) * r
+      + 1.48753612908506148525e-2) * r + 1.36929880922735805310e-1) * r
+      + 5.99832206555887937690e-1) * r + 1.0);
+}
+} // namespace sfinx::aux
+
+/**
+ * Quantile of the standard normal distribution for p in (0, 1), Wichura's AS 241
+ **/
+inline double inverse_normal_cdf(double p)
+{
+  double q = p - 0.5;
+  if (std::fabs(q) <= 0.425)
+    return aux::as241_central(q);
+  double r = sqrt(-log(q < 0 ? p : 1 - p));
+  double x = r <= 5 ? aux::as241_near(r) : aux::as241_far(r);
+  return q < 0 ? -x : x;
+}
+
+/**
+ * Bivariate normal distribution P(X < a, Y < b) with correlation rho, A. Genz's algorithm
+ * (Statistics and Computing 14, 2004) with Gauss-Legendre rules of 6, 12 or 20 points by |rho|,
+ * accurate to about 1e-15
+ **/
+inline double bivariate_normal_cdf(double a, double b, double rho)
+{
+  static double const x[3][10] = {
+    { -0.9324695142031522, -0.6612093864662647, -0.2386191860831970 },
+    { -0.9815606342467191, -0.9041172563704750, -0.7699026741943050, -0.5873179542866171,
+      -0.3678314989981802, -0.1252334085114692 },
+    { -0.9931285991850949, -0.9639719272779138, -0.9122344282513259, -0.8391169718222188,
+      -0.7463319064601508, -0.6360536807265150, -0.5108670019508271, -0.3737060887154196,
+      -0.2277858511416451, -0.07652652113349733 } };
+  static double const w[3][10] = {
+    { 0.1713244923791705, 0.3607615730481384, 0.4679139345726904 },
+    { 0.04717533638651177, 0.1069393259953183, 0.1600783285433464, 0.2031674267230659,
+      0.2334925365383547, 0.2491470458134029 },
+    { 0.01761400713915212, 0.04060142980038694, 0.06267204833410906, 0.08327674157670475,
+      0.1019301198172404, 0.1181945319615184, 0.1316886384491766, 0.1420961093183821,
+      0.1491729864726037, 0.1527533871307259 } };
+  int ng = std::fabs(rho) < 0.3 ? 0 : std::fabs(rho) < 0.75 ? 1 : 2;
+  int lg = ng == 0 ? 3 : ng == 1 ? 6 : 10;
+  double h = -a, k = -b, hk = h * k, bvn = 0;
+  if (std::fabs(rho) < 0.925) {
+    double hs = (h * h + k * k) / 2, asr = std::asin(rho);
+    for (int i = 0; i < lg; ++i)
+      for (int is = -1; is <= 1; is += 2) {
+        double sn = std::sin(asr * (is * x[ng][i] + 1) / 2);
+        bvn += w[ng][i] * std::exp((sn * hk - hs) / (1 - sn * sn));
+      }
+    return bvn * asr / (4 * Pi) + normal_cdf(-h) * normal_cdf(-k);
+  }
+  if (rho < 0) {
+    k = -k;
+    hk = -hk;
+  }
+  if (std::fabs(rho) < 1) {
+    double as = (1 - rho) * (1 + rho), A = std::sqrt(as), bs = (h - k) * (h - k);
+    double c = (4 - hk) / 8, d = (12 - hk) / 16;
+    bvn = A * std::exp(-(bs / as + hk) / 2) * (1 - c * (bs - as) * (1 - d * bs / 5) / 3
+                                               + c * d * as * as / 5);
+    if (hk > -160) {
+      double B = std::sqrt(bs);
+      bvn -= std::exp(-hk / 2) * std::sqrt(2 * Pi) * normal_cdf(-B / A) * B
+          * (1 - c * bs * (1 - d * bs / 5) / 3);
+    }
+    A /= 2;
+    for (int i = 0; i < lg; ++i)
+      for (int is = -1; is <= 1; is += 2) {
+        double xs = A * (is * x[ng][i] + 1);
+        xs *= xs;
+        double rs = std::sqrt(1 - xs), asr = -(bs / xs + hk) / 2;
+        if (asr > -100)
+          bvn += A * w[ng][i] * std::exp(asr)
+              * (std::exp(-hk * (1 - rs) / (2 * (1 + rs))) / rs - (1 + c * xs * (1 + d * xs)));
+      }
+    bvn = -bvn / (2 * Pi);
+  }
+  if (rho > 0)
+    return bvn + normal_cdf(-std::max(h, k));
+  bvn = -bvn;
+  if (k > h)
+    bvn += normal_cdf(k) - normal_cdf(h);
+  return bvn;
+}
+
+/**
+ * Accuracy tiers of the normal distribution primitives, as compile-time policies for the pricers
+ *   normal::exact     libm erfc, exact to the last couple of ulps
+ *   normal::rational  W. J. Cody's rational approximation of erfc, error below 1e-15 (1e-10 bound)
+ *   normal::fast      Abramowitz-Stegun 26.2.17 polynomial, absolute error below 7.5e-8
+ * The density only needs exp and is exact in every tier. Each tier has float and double
+ * overloads here, the simd::pack ones live in simd.hpp and are found by argument-dependent lookup.
+ **/
+namespace normal {
+
+inline double exact_cdf(double x) { return normal_cdf(x); }
+inline float exact_cdf(float x) { return std::erfc(-x * 0.70710678f) / 2; }
+inline double exact_pdf(double x) { return normal_pdf(x); }
+inline float exact_pdf(float x) { return 0.39894228f * std::exp(-0.5f * x * x); }
+
+namespace aux {
+inline double cody_erfc(double x)
+{
+  double y = std::fabs(x), num, den, ret;
+  if (y <= 0.46875) {
+    double z = y * y;
+    num = 1.85777706184603153e-1 * z; den = z;
+    num = (num + 3.16112374387056560e00) * z;  den = (den + 2.36012909523441209e01) * z;
+    num = (num + 1.13864154151050156e02) * z;  den = (den + 2.44024637934444173e02) * z;
+    num = (num + 3.77485237685302021e02) * z;  den = (den + 1.28261652607737228e03) * z;
+    return 1 - x * (num + 3.20937758913846947e03) / (den + 2.84423683343917062e03);
+  }
+  if (y <= 4) {
+    num = 2.15311535474403846e-8 * y; den = y;
+    num = (num + 5.64188496988670089e-1) * y;  den = (den + 1.57449261107098347e01) * y;
+    num = (num + 8.88314979438837594e00) * y;  den = (den + 1.17693950891312499e02) * y;
+    num = (num + 6.61191906371416295e01) * y;  den = (den + 5.37181101862009858e02) * y;
+    num = (num + 2.98635138197400131e02) * y;  den = (den + 1.62138957456669019e03) * y;
+    num = (num + 8.81952221241769090e02) * y;  den = (den + 3.29079923573345963e03) * y;
+    num = (num + 1.71204761263407058e03) * y;  den = (den + 4.36261909014324716e03) * y;
+    num = (num + 2.05107837782607147e03) * y;  den = (den + 3.43936767414372164e03) * y;
+    ret = (num + 1.23033935479799725e03) / (den + 1.23033935480374942e03);
+  } else if (y < 26.55) {
+    double z = 1 / (y * y);
+    num = 1.63153871373020978e-2 * z; den = z;
+    num = (num + 3.05326634961232344e-1) * z;  den = (den + 2.56852019228982242e00) * z;
+    num = (num + 3.60344899949804439e-1) * z;  den = (den + 1.87295284992346725e00) * z;
+    num = (num + 1.25781726111229246e-1) * z;  den = (den + 5.27905102951428412e-1) * z;
+    num = (num + 1.60837851487422766e-2) * z;  den = (den + 6.05183413124413191e-2) * z;
+    ret = z * (num + 6.58749161529837803e-4) / (den + 2.33520497626869185e-3);
+    ret = (5.6418958354775628695e-1 - ret) / y;
+  } else {
+    ret = 0;
+  }
+  // exp(-y^2) split so that the rounding of y^2 does not leak into the tail
+  double ysq = std::trunc(y * 16) / 16, del = (y - ysq) * (y + ysq);
+  ret *= std::exp(-ysq * ysq) * std::exp(-del);
+  return x < 0 ? 2 - ret : ret;
+}
+} // namespace sfinx::normal::aux
+
+inline double rational_cdf(double x) { return aux::cody_erfc(-x * 0.70710678118654752440) / 2; }
+inline float rational_cdf(float x) { return float(rational_cdf(double(x))); }
+
+inline double fast_cdf(double x)
+{
+  double y = std::fabs(x), t = 1 / (1 + 0.2316419 * y);
+  double q = normal_pdf(y) * t * (0.319381530 + t * (-0.356563782 + t * (1.781477937
+             + t * (-1.821255978 + t * 1.330274429))));
+  return x < 0 ? q : 1 - q;
+}
+
+inline float fast_cdf(float x)
+{
+  float y = std::fabs(x), t = 1 / (1 + 0.2316419f * y);
+  float q = exact_pdf(y) * t * (0.319381530f + t * (-0.356563782f + t * (1.781477937f
+            + t * (-1.821255978f + t * 1.330274429f))));
+  return x < 0 ? q : 1 - q;
+}
+
+struct exact
+{
+  template <typename Num> static Num cdf(Num x) { return exact_cdf(x); }
+  template <typename Num> static Num pdf(Num x) { return exact_pdf(x); }
+};
+
+struct rational
+{
+  template <typename Num> static Num cdf(Num x) { return rational_cdf(x); }
+  template <typename Num> static Num pdf(Num x) { return exact_pdf(x); }
+};
+
+struct fast
+{
+  template <typename Num> static Num cdf(Num x) { return fast_cdf(x); }
+  template <typename Num> static Num pdf(Num x) { return exact_pdf(x); }
+};
+
+} // namespace sfinx::normal
+
 } // namespace sfinx
 
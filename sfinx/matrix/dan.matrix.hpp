@@ -53,6 +53,31 @@ TEST(matrix, inverse)
   EXPECT_TRUE(mr == inverse(m));
 }
 
+TEST(matrix, solve)
+{
+  auto m = matrix<double, 2, 2>();
+  auto b = matrix<double, 2, 1>();
+  m << 4, 2, 2, 3;
+  b << 2, 1;
+  auto x = solve(m, b);
+  EXPECT_DOUBLE_EQ(x(0), 0.5);
+  EXPECT_NEAR(x(1), 0.0, 1e-15);
+  auto l = cholesky(m);
+  EXPECT_DOUBLE_EQ(l(0, 0), 2.0);
+  EXPECT_DOUBLE_EQ(l(0, 1), 0.0);
+  EXPECT_DOUBLE_EQ(l(1, 0), 1.0);
+  EXPECT_DOUBLE_EQ(l(1, 1), std::sqrt(2.0));
+
+  // line through (0, 1), (1, 3), (2, 4): 7 / 6 + 3 / 2 x
+  auto a = matrix<double, 3, 2>();
+  auto y = matrix<double, 3, 1>();
+  a << 1, 0, 1, 1, 1, 2;
+  y << 1, 3, 4;
+  auto c = least_squares(a, y);
+  EXPECT_NEAR(c(0), 7.0 / 6, 1e-14);
+  EXPECT_NEAR(c(1), 1.5, 1e-14);
+}
+
 TEST(matrix, eigenvalues)
 {
   auto m = matrix<double, 2, 2>();
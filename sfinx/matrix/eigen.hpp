@@ -65,6 +65,27 @@ inline Mx inverse(Mx const& m)
   return m.inverse();
 }
 
+/// Solve m x = b for symmetric positive definite m, Cholesky (LDLT) instead of the inverse
+template <typename Mx, typename Vx>
+inline Vx solve(Mx const& m, Vx const& b)
+{
+  return m.ldlt().solve(b);
+}
+
+/// Lower triangular L of m = L L' for symmetric positive definite m
+template <typename Mx>
+inline Mx cholesky(Mx const& m)
+{
+  return m.llt().matrixL();
+}
+
+/// Least squares x of m x = b, column pivoting Householder QR
+template <typename Mx, typename Vx>
+inline auto least_squares(Mx const& m, Vx const& b) -> decltype(col_type(transpose_type(m)))
+{
+  return m.colPivHouseholderQr().solve(b);
+}
+
 template <typename Mx>
 inline auto eigenvalues(Mx const& m) -> decltype(col_type(m))
 {
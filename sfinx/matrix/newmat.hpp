@@ -58,6 +58,24 @@ inline Matrix inverse(Matrix const& m)
   return m.i();
 }
 
+/// Newmat evaluates i() * b as an LU solve, the inverse is not formed
+inline ColumnVector solve(Matrix const& m, ColumnVector const& b)
+{
+  return m.i() * b;
+}
+
+inline Matrix cholesky(Matrix const& m)
+{
+  SymmetricMatrix s(m.Nrows());
+  s << m;
+  return Cholesky(s);
+}
+
+inline ColumnVector least_squares(Matrix const& m, ColumnVector const& b)
+{
+  return (m.t() * m).i() * (m.t() * b);
+}
+
 inline RowVector eigenvalues(Matrix const& m)
 {
   //DiagonalMatrix d;
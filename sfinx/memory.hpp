@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace sfinx {
+
+/**
+ * Allocator of storage aligned to Align bytes, 64 puts every array on its own cache lines and
+ * lets full width vector loads start at element 0. Over-allocates by Align and keeps the
+ * address of the raw block in the word before the aligned one.
+ **/
+template <typename T, size_t Align = 64>
+struct aligned_allocator
+{
+  static_assert(Align >= sizeof(void*) && (Align & (Align - 1)) == 0,
+                "alignment must be a power of two of at least a pointer");
+  typedef T value_type;
+
+  template <typename U>
+  struct rebind
+  {
+    typedef aligned_allocator<U, Align> other;
+  };
+
+  aligned_allocator() {}
+
+  template <typename U>
+  aligned_allocator(aligned_allocator<U, Align> const&) {}
+
+  T* allocate(size_t n)
+  {
+    char* raw = static_cast<char*>(::operator new(n * sizeof(T) + Align));
+    char* p = raw + Align - reinterpret_cast<uintptr_t>(raw) % Align;
+    reinterpret_cast<void**>(p)[-1] = raw;
+    return reinterpret_cast<T*>(p);
+  }
+
+  void deallocate(T* p, size_t)
+  {
+    ::operator delete(reinterpret_cast<void**>(p)[-1]);
+  }
+};
+
+template <typename T, typename U, size_t Align>
+bool operator==(aligned_allocator<T, Align> const&, aligned_allocator<U, Align> const&)
+{
+  return true;
+}
+
+template <typename T, typename U, size_t Align>
+bool operator!=(aligned_allocator<T, Align> const&, aligned_allocator<U, Align> const&)
+{
+  return false;
+}
+
+} // namespace sfinx
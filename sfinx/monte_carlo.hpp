@@ -0,0 +1,233 @@
+#pragma once
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "math.hpp"
+#include "simd.hpp"
+#include "random.hpp"
+#include "qmc.hpp"
+#include "thread_pool.hpp"
+#include "black_scholes.hpp"
+
+namespace sfinx { namespace mc {
+
+enum class Barrier
+{
+  DownOut, DownIn, UpOut, UpIn
+};
+
+/// The fixings of a pack of paths at expiry, min and max include the spot at inception
+struct fixings
+{
+  simd::pack last, mean, min, max;
+};
+
+/// Arithmetic average price option over the monitoring dates
+template <option::Type t>
+struct asian
+{
+  static constexpr option::Type type = t;
+  double X;
+
+  simd::pack operator()(fixings const& f) const
+  {
+    return simd::max(simd::pack(type == option::Type::Call ? 1.0 : -1.0) * (f.mean - X), 0.0);
+  }
+
+  double strike(double) const { return X; }
+};
+
+/// Knock in or knock out vanilla with barrier H monitored at the fixing dates
+template <option::Type t, Barrier kind>
+struct barrier
+{
+  static constexpr option::Type type = t;
+  double X, H;
+
+  simd::pack operator()(fixings const& f) const
+  {
+    bool down = kind == Barrier::DownOut || kind == Barrier::DownIn;
+    bool in = kind == Barrier::DownIn || kind == Barrier::UpIn;
+    auto hit = down ? f.min <= H : f.max >= H;
+    simd::pack v = simd::max(simd::pack(type == option::Type::Call ? 1.0 : -1.0) * (f.last - X),
+                             0.0);
+    return in ? simd::select(hit, v, 0.0) : simd::select(hit, 0.0, v);
+  }
+
+  double strike(double) const { return X; }
+};
+
+/// Floating strike lookback, the last fixing against the extreme one
+template <option::Type t>
+struct lookback
+{
+  static constexpr option::Type type = t;
+
+  simd::pack operator()(fixings const& f) const
+  {
+    return type == option::Type::Call ? f.last - f.min : f.max - f.last;
+  }
+
+  double strike(double S) const { return S; }
+};
+
+struct settings
+{
+  size_t paths = 1 << 16;      // rounded up to whole blocks
+  size_t steps = 12;           // equally spaced fixings, the last at expiry
+  uint64_t seed = 0;
+  bool antithetic = true;
+  bool control = true;         // vanilla with the payoff's strike as control variate
+  bool quasi = false;          // scrambled Sobol points and a Brownian bridge, seed scrambles
+};
+
+struct result
+{
+  double value, error;         // estimate and its standard error
+  size_t paths;
+};
+
+namespace aux {
+
+/// Paths per block, the state of a block stays in L1 cache while it is stepped
+size_t const block = 256;
+
+/// Quasi random source, shared read only by all blocks
+struct quasi
+{
+  qmc::sobol seq;
+  qmc::brownian_bridge bridge;
+
+  explicit quasi(settings const& s) : seq(s.steps, true, s.seed), bridge(s.steps) {}
+};
+
+/// Sums of the discounted payoffs y and controls c over the samples of a block
+struct moments
+{
+  double n, y, c, yy, cc, yc;
+};
+
+/**
+ * Simulate block j with exact log normal steps. The state of the block is held structure of
+ * arrays and stepped a pack of paths at a time. Draws come from the counter based stream of
+ * the block or from points of the Sobol sequence at the block's offset, so the result of a
+ * block does not depend on the thread that runs it. With q the normals of a Sobol point build
+ * the whole path through the bridge and the unit increments drive the steps.
+ **/
+template <typename Payoff>
+moments simulate(Payoff const& payoff, size_t j, double S, double T, double r, double b,
+                 double v, settings const& s, quasi const* q)
+{
+  size_t const W = simd::pack::size, m = s.antithetic ? block / 2 : block;
+  alignas(64) double last[block], sum[block], lo[block], hi[block], z[block];
+  std::fill(last, last + block, S);
+  std::fill(sum, sum + block, 0.0);
+  std::fill(lo, lo + block, S);
+  std::fill(hi, hi + block, S);
+
+  std::vector<double> u, w;
+  if (q) {
+    u.resize(s.steps * m);
+    w.resize(s.steps * m);
+    q->seq.normals(uint64_t(j) * m, m, u.data());
+    q->bridge.transform(u.data(), w.data(), m);
+  }
+
+  double dt = T / s.steps;
+  simd::pack drift((b - v * v / 2) * dt), vol(v * sqrt(dt));
+  for (size_t k = 0; k < s.steps; ++k) {
+    if (q)
+      for (size_t i = 0; i < m; ++i)
+        z[i] = w[k * m + i] - (k == 0 ? 0.0 : w[(k - 1) * m + i]);
+    else
+      random::normals(s.seed, uint64_t(j) * m, uint32_t(k), z, m);
+    for (size_t i = m; i < block; ++i)
+      z[i] = -z[i - m];
+    for (size_t i = 0; i < block; i += W) {
+      simd::pack x = simd::pack::load(last + i) * exp(drift + vol * simd::pack::load(z + i));
+      x.store(last + i);
+      (simd::pack::load(sum + i) + x).store(sum + i);
+      simd::min(simd::pack::load(lo + i), x).store(lo + i);
+      simd::max(simd::pack::load(hi + i), x).store(hi + i);
+    }
+  }
+
+  // payoffs over last and controls over sum, in place
+  double X = payoff.strike(S), df = exp(-r * T);
+  simd::pack phi(Payoff::type == option::Type::Call ? 1.0 : -1.0), n(double(s.steps));
+  for (size_t i = 0; i < block; i += W) {
+    fixings f = { simd::pack::load(last + i), simd::pack::load(sum + i) / n,
+                  simd::pack::load(lo + i), simd::pack::load(hi + i) };
+    (payoff(f) * df).store(last + i);
+    (simd::max(phi * (f.last - X), 0.0) * df).store(sum + i);
+  }
+
+  moments a = { double(m), 0, 0, 0, 0, 0 };
+  for (size_t i = 0; i < m; ++i) {
+    double y = s.antithetic ? (last[i] + last[i + m]) / 2 : last[i];
+    double c = s.antithetic ? (sum[i] + sum[i + m]) / 2 : sum[i];
+    a.y += y;
+    a.c += c;
+    a.yy += y * y;
+    a.cc += c * c;
+    a.yc += y * c;
+  }
+  return a;
+}
+
+/// Reduce the blocks in order and apply the control variate with its regression coefficient
+inline result estimate(std::vector<moments> const& blocks, double control, bool use)
+{
+  moments t = { 0, 0, 0, 0, 0, 0 };
+  for (auto const& a : blocks) {
+    t.n += a.n; t.y += a.y; t.c += a.c; t.yy += a.yy; t.cc += a.cc; t.yc += a.yc;
+  }
+  double my = t.y / t.n, mc = t.c / t.n;
+  double vy = t.yy / t.n - my * my, vc = t.cc / t.n - mc * mc, cyc = t.yc / t.n - my * mc;
+  double beta = use && vc > 0 ? cyc / vc : 0;
+  result res;
+  res.value = my - beta * (mc - control);
+  res.error = sqrt(std::max(vy - beta * cyc, 0.0) / (t.n - 1));
+  res.paths = blocks.size() * block;
+  return res;
+}
+
+} // namespace sfinx::mc::aux
+
+/**
+ * Monte Carlo value of a path dependent payoff under generalized Black-Scholes-Merton dynamics,
+ * blocks of paths are spread over the pool. Results are bit identical for any pool size and
+ * any rerun with the same settings. With quasi the error is still the sample standard error,
+ * which overstates the error of a low discrepancy estimate; the spread over a few seeds is
+ * the honest measure.
+ **/
+template <typename Payoff>
+result value(Payoff const& payoff, double S, double T, double r, double b, double v,
+             settings const& s, thread_pool& pool)
+{
+  assert(s.steps > 0 && s.paths > 0);
+  std::vector<aux::moments> blocks((s.paths + aux::block - 1) / aux::block);
+  std::unique_ptr<aux::quasi> q(s.quasi ? new aux::quasi(s) : nullptr);
+  pool.parallel_for(blocks.size(), [&](size_t j) {
+    blocks[j] = aux::simulate(payoff, j, S, T, r, b, v, s, q.get());
+  });
+  double X = payoff.strike(S);
+  double control = Payoff::type == option::Type::Call ? bsm_general::call(S, X, T, r, b, v)
+                                                      : bsm_general::put(S, X, T, r, b, v);
+  return aux::estimate(blocks, control, s.control);
+}
+
+/// On the calling thread
+template <typename Payoff>
+result value(Payoff const& payoff, double S, double T, double r, double b, double v,
+             settings const& s)
+{
+  thread_pool inline_pool(1);
+  return value(payoff, S, T, r, b, v, s, inline_pool);
+}
+
+} } // namespace sfinx::mc
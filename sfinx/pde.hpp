@@ -0,0 +1,269 @@
+#pragma once
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <vector>
+#include "math.hpp"
+#include "span.hpp"
+#include "black_scholes.hpp"
+
+namespace sfinx { namespace pde {
+
+/// Value with delta, gamma and theta, theta is per year of calendar time
+template <typename Num>
+struct result
+{
+  Num value, delta, gamma, theta;
+};
+
+namespace aux {
+
+/**
+ * Thomas factorization of a tridiagonal matrix with constant interior rows (l, m, p) and
+ * identity boundary rows. Forward eliminates below the diagonal and substitutes back from the
+ * top, reverse eliminates above it and substitutes forward from the bottom. The projected
+ * substitution is the Brennan-Schwartz step: clamping each unknown to the exercise value as it
+ * is found is exact when the exercise region sits where the substitution starts.
+ **/
+struct factor
+{
+  std::vector<double> c, inv;
+
+  void forward(size_t n, double l, double m, double p)
+  {
+    c.resize(n);
+    inv.resize(n);
+    c[0] = 0;
+    inv[0] = 1;
+    for (size_t i = 1; i + 1 < n; ++i) {
+      inv[i] = 1 / (m - l * c[i - 1]);
+      c[i] = p * inv[i];
+    }
+    c[n - 1] = 0;
+    inv[n - 1] = 1;
+  }
+
+  void reverse(size_t n, double l, double m, double p)
+  {
+    c.resize(n);
+    inv.resize(n);
+    c[n - 1] = 0;
+    inv[n - 1] = 1;
+    for (size_t i = n - 1; --i > 0;) {
+      inv[i] = 1 / (m - p * c[i + 1]);
+      c[i] = l * inv[i];
+    }
+    c[0] = 0;
+    inv[0] = 1;
+  }
+};
+
+/// Solve in place with the forward factor, d is the right hand side and becomes the solution
+inline void solve_forward(factor const& f, double l, double* d, double const* g, size_t n)
+{
+  for (size_t i = 1; i + 1 < n; ++i)
+    d[i] = (d[i] - l * d[i - 1]) * f.inv[i];
+  if (g)
+    d[n - 1] = std::max(d[n - 1], g[n - 1]);
+  for (size_t i = n - 1; i-- > 0;) {
+    d[i] -= f.c[i] * d[i + 1];
+    if (g)
+      d[i] = std::max(d[i], g[i]);
+  }
+}
+
+inline void solve_reverse(factor const& f, double p, double* d, double const* g, size_t n)
+{
+  for (size_t i = n - 1; --i > 0;)
+    d[i] = (d[i] - p * d[i + 1]) * f.inv[i];
+  if (g)
+    d[0] = std::max(d[0], g[0]);
+  for (size_t i = 1; i < n; ++i) {
+    d[i] -= f.c[i] * d[i - 1];
+    if (g)
+      d[i] = std::max(d[i], g[i]);
+  }
+}
+
+} // namespace sfinx::pde::aux
+
+/**
+ * Crank-Nicolson solver of the generalized Black-Scholes-Merton equation on a uniform grid in
+ * log moneyness z = log(S / X) with unit strike. The value is homogeneous in (S, X), so one
+ * solve prices every strike and spot level that falls on the grid. The first two time steps are
+ * replaced by four implicit Euler half steps (Rannacher) to damp the payoff kink, which sits on
+ * the centre node. A half step of implicit Euler has the same matrix 1 - dt / 2 L as a Crank-
+ * Nicolson step, so both share one factorization. American exercise is a Brennan-Schwartz
+ * projection in the Thomas solve.
+ *
+ * The grid, the work arrays and the factored operators are kept between calls and are only
+ * rebuilt by reset with different (T, r, b, v).
+ **/
+class solver
+{
+public:
+  solver(double T, double r, double b, double v, size_t nx = 400, size_t nt = 200,
+         double width = 6)
+    : nx_(nx + nx % 2), nt_(nt), width_(width), T_(NAN), r_(NAN), b_(NAN), v_(NAN),
+      phi_(0), american_(false), factorizations_(0), solves_(0)
+  {
+    assert(nx_ >= 4 && nt_ >= 2 && width_ > 0);
+    z_.resize(nx_ + 1);
+    u_.resize(nx_ + 1);
+    g_.resize(nx_ + 1);
+    reset(T, r, b, v);
+  }
+
+  /// Refactor for new parameters, a no-op when they are unchanged
+  void reset(double T, double r, double b, double v)
+  {
+    if (T == T_ && r == r_ && b == b_ && v == v_)
+      return;
+    T_ = T; r_ = r; b_ = b; v_ = v;
+    size_t n = nx_ + 1;
+    double zmax = width_ * v * sqrt(T) + std::abs(b - v * v / 2) * T;
+    dz_ = 2 * zmax / nx_;
+    for (size_t i = 0; i < n; ++i)
+      z_[i] = (double(i) - double(nx_ / 2)) * dz_;
+
+    // L u = lo u[i-1] + mid u[i] + up u[i+1]
+    double a = v * v / (2 * dz_ * dz_), c = (b - v * v / 2) / (2 * dz_);
+    lo_ = a - c;
+    mid_ = -2 * a - r;
+    up_ = a + c;
+    dt_ = T / nt_;
+    lhs_[0].forward(n, -dt_ / 2 * lo_, 1 - dt_ / 2 * mid_, -dt_ / 2 * up_);
+    lhs_[1].reverse(n, -dt_ / 2 * lo_, 1 - dt_ / 2 * mid_, -dt_ / 2 * up_);
+    ++factorizations_;
+    solves_ = 0;
+    phi_ = 0;
+  }
+
+  /// Solve for the unit strike surface of a call or a put
+  template <option::Type type, option::Exercise exercise = option::Exercise::American>
+  void solve()
+  {
+    static_assert(type != option::Type::Both, "a call or a put");
+    phi_ = type == option::Type::Call ? 1 : -1;
+    american_ = exercise == option::Exercise::American;
+    size_t n = nx_ + 1;
+    for (size_t i = 0; i < n; ++i)
+      u_[i] = g_[i] = std::max(phi_ * (exp(z_[i]) - 1), 0.0);
+
+    // Brennan-Schwartz substitutes from the exercise side, the top for calls
+    size_t k = phi_ > 0 ? 0 : 1;
+    double const* g = american_ ? g_.data() : nullptr;
+    for (size_t j = 0; j < 4; ++j)
+      step(k, 0, (j + 1) * dt_ / 2, g);
+    for (size_t j = 2; j < nt_; ++j)
+      step(k, dt_ / 2, (j + 1) * dt_, g);
+    ++solves_;
+  }
+
+  /// Value and greeks at spot S for strike X, cubic in z through the four nearest nodes
+  result<double> at(double S, double X) const
+  {
+    assert(phi_ != 0);
+    double z = log(S / X) / dz_ + double(nx_ / 2);
+    size_t i = size_t(std::min(std::max(std::floor(z), 1.0), double(nx_ - 2)));
+    double t = z - double(i), p0 = u_[i - 1], p1 = u_[i], p2 = u_[i + 1], p3 = u_[i + 2];
+    double a1 = p2 - p0 / 3 - p1 / 2 - p3 / 6, a2 = (p0 + p2) / 2 - p1;
+    double a3 = (p3 - p0) / 6 + (p1 - p2) / 2;
+    double u = p1 + t * (a1 + t * (a2 + t * a3));
+    double uz = (a1 + t * (2 * a2 + 3 * t * a3)) / dz_, uzz = (2 * a2 + 6 * t * a3) / (dz_ * dz_);
+    double payoff = std::max(phi_ * (S - X), 0.0);
+    return greeks(S, X, u, uz, uzz, american_ && X * u <= payoff);
+  }
+
+  /// A strike chain at one spot
+  void at(double S, span<double const> X, result<span<double>> const& out) const
+  {
+    for (size_t i = 0; i < X.size(); ++i)
+      write(out, i, at(S, X[i]));
+  }
+
+  /**
+   * The whole surface for strike X, the spot level of every node goes to S and the value and
+   * greeks there to out, all of size size()
+   **/
+  void surface(double X, span<double> S, result<span<double>> const& out) const
+  {
+    assert(phi_ != 0 && S.size() == size());
+    for (size_t i = 0; i < size(); ++i) {
+      size_t k = std::min(std::max(i, size_t(1)), nx_ - 1);
+      double uz = (u_[k + 1] - u_[k - 1]) / (2 * dz_);
+      double uzz = (u_[k + 1] - 2 * u_[k] + u_[k - 1]) / (dz_ * dz_);
+      S[i] = X * exp(z_[i]);
+      write(out, i, greeks(S[i], X, u_[i], uz, uzz, american_ && u_[i] <= g_[i]));
+    }
+  }
+
+  size_t size() const { return nx_ + 1; }
+  span<double const> log_moneyness() const { return z_; }
+  span<double const> values() const { return u_; }
+  size_t factorizations() const { return factorizations_; }
+  size_t solves() const { return solves_; }
+
+private:
+  /// Dirichlet values at both ends, the forward minus the discounted strike deep in the money
+  void boundary(double tau)
+  {
+    double fwd = exp((b_ - r_) * tau), df = exp(-r_ * tau);
+    double& itm = phi_ > 0 ? u_[nx_] : u_[0];
+    double S = exp(phi_ > 0 ? z_[nx_] : z_[0]);
+    itm = phi_ * (S * fwd - df);
+    if (american_)
+      itm = std::max(itm, phi_ * (S - 1));
+    (phi_ > 0 ? u_[0] : u_[nx_]) = 0;
+  }
+
+  /// One step (1 - dt / 2 L) u' = (1 + e L) u to time to maturity tau
+  void step(size_t k, double e, double tau, double const* g)
+  {
+    if (e != 0) {
+      double prev = u_[0];
+      for (size_t i = 1; i < nx_; ++i) {
+        double ui = u_[i];
+        u_[i] = ui + e * (lo_ * prev + mid_ * ui + up_ * u_[i + 1]);
+        prev = ui;
+      }
+    }
+    boundary(tau);
+    if (k == 0)
+      aux::solve_forward(lhs_[0], -dt_ / 2 * lo_, u_.data(), g, nx_ + 1);
+    else
+      aux::solve_reverse(lhs_[1], -dt_ / 2 * up_, u_.data(), g, nx_ + 1);
+  }
+
+  result<double> greeks(double S, double X, double u, double uz, double uzz, bool exercised) const
+  {
+    result<double> res;
+    res.value = X * u;
+    res.delta = X * uz / S;
+    res.gamma = X * (uzz - uz) / (S * S);
+    res.theta = exercised ? 0
+        : -(v_ * v_ / 2 * S * S * res.gamma + b_ * S * res.delta - r_ * res.value);
+    return res;
+  }
+
+  static void write(result<span<double>> const& out, size_t i, result<double> const& g)
+  {
+    out.value[i] = g.value;
+    if (!out.delta.empty()) out.delta[i] = g.delta;
+    if (!out.gamma.empty()) out.gamma[i] = g.gamma;
+    if (!out.theta.empty()) out.theta[i] = g.theta;
+  }
+
+  size_t nx_, nt_;
+  double width_;
+  double T_, r_, b_, v_;
+  double dz_, dt_, lo_, mid_, up_;
+  double phi_;
+  bool american_;
+  std::vector<double> z_, u_, g_;
+  aux::factor lhs_[2];   // forward and reverse
+  size_t factorizations_, solves_;
+};
+
+} } // namespace sfinx::pde
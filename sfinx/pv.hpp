@@ -1,5 +1,6 @@
 #pragma once
 #include <cmath>
+#include <iterator>
 #include <type_traits>
 #include <utility>
 #include "math.hpp"
@@ -31,5 +32,59 @@ auto pv(T const& times, U const& amounts, Ret r)
     );
 }
 
+/// Present value and its first two derivatives in the rate
+struct pv_sensitivities
+{
+  double pv, dpv, d2pv;
+};
+
+/// pv, dpv/dr and d2pv/dr2 from one walk over the cashflows, one discount factor each
+template <Flow F, typename T, typename U>
+pv_sensitivities pv_derivatives(T const& times, U const& amounts, double r)
+{
+  pv_sensitivities s = { 0, 0, 0 };
+  double g = F == Flow::Discrete ? 1 / (1 + r) : 1;
+  auto ti = std::begin(times);
+  auto ci = std::begin(amounts);
+  for (; ti != std::end(times) && ci != std::end(amounts); ++ti, ++ci) {
+    double t = *ti;
+    double v = *ci * (F == Flow::Discrete ? discount_factor(r, t, 1) : discount_factor(r, t));
+    s.pv += v;
+    s.dpv -= t * v;
+    s.d2pv += t * (F == Flow::Discrete ? t + 1 : t) * v;
+  }
+  s.dpv *= g;
+  s.d2pv *= g * g;
+  return s;
+}
+
+namespace aux {
+
+/**
+ * Starting yield for the flows against price paid at time 0: the inflows and the outflows
+ * each collapsed to one flow at their duration at zero rate, and the rate that equates them.
+ **/
+template <Flow F, typename T, typename U>
+double yield_guess(T const& times, U const& amounts, double price)
+{
+  double in = 0, tin = 0, out = price, tout = 0;
+  auto ti = std::begin(times);
+  auto ci = std::begin(amounts);
+  for (; ti != std::end(times) && ci != std::end(amounts); ++ti, ++ci)
+    if (*ci > 0) {
+      in += *ci;
+      tin += *ti * *ci;
+    } else {
+      out -= *ci;
+      tout -= *ti * *ci;
+    }
+  if (!(in > 0 && out > 0 && tin / in > tout / out))
+    return 0;
+  double y = log(in / out) / (tin / in - tout / out);
+  return F == Flow::Discrete ? exp(y) - 1 : y;
+}
+
+} // namespace sfinx::aux
+
 } // namespace sfinx
 
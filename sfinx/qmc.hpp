@@ -0,0 +1,210 @@
+#pragma once
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "math.hpp"
+#include "simd.hpp"
+#include "span.hpp"
+#include "random.hpp"
+#include "sobol_table.hpp"
+
+namespace sfinx { namespace qmc {
+
+/**
+ * Sobol low discrepancy sequence in up to 1024 dimensions with the Joe-Kuo direction numbers
+ * and 32 bit resolution. Points are random access, points(first, n) costs one Gray code jump
+ * and n - 1 xors per dimension, so chunks of the sequence go to threads independently.
+ *
+ * A scrambled sequence applies a random linear matrix scramble (Matousek) and a digital shift
+ * to every dimension, drawn from the philox stream of seed. It keeps the net structure of the
+ * points and makes them uniform on (0, 1) each, so independent seeds give error estimates.
+ * Point 0 of the plain sequence is the origin, which has no normal quantile; skip it.
+ **/
+class sobol
+{
+public:
+  sobol(size_t dimension, bool scramble = false, uint64_t seed = 0)
+    : dim_(dimension), v_(dimension * 32), shift_(dimension, 0)
+  {
+    assert(dimension > 0 && dimension <= aux::sobol_dimensions);
+    unsigned short const* poly = aux::sobol_poly();
+    unsigned short const* m = aux::sobol_m();
+    for (size_t j = 0; j < 32; ++j)
+      v_[j] = 1u << (31 - j);
+    for (size_t k = 1; k < dim_; ++k) {
+      uint32_t* v = &v_[k * 32];
+      unsigned p = poly[k - 1], s = 0;
+      while (p >> (s + 1))
+        ++s;
+      unsigned a = (p >> 1) & ((1u << (s - 1)) - 1);
+      for (unsigned j = 0; j < s; ++j)
+        v[j] = uint32_t(m[j]) << (31 - j);
+      m += s;
+      for (unsigned j = s; j < 32; ++j) {
+        v[j] = v[j - s] ^ (v[j - s] >> s);
+        for (unsigned l = 1; l < s; ++l)
+          if ((a >> (s - 1 - l)) & 1)
+            v[j] ^= v[j - l];
+      }
+    }
+    if (scramble)
+      for (size_t k = 0; k < dim_; ++k)
+        scramble_dimension(k, seed);
+  }
+
+  size_t dimension() const { return dim_; }
+
+  /// Points first, ..., first + n - 1 in (0, 1), dimension major, x[k * n + i]
+  void points(uint64_t first, size_t n, double* x) const
+  {
+    for (size_t k = 0; k < dim_; ++k) {
+      uint32_t const* v = &v_[k * 32];
+      uint32_t y = shift_[k];
+      for (uint64_t g = first ^ (first >> 1), j = 0; g; g >>= 1, ++j)
+        if (g & 1)
+          y ^= v[j];
+      double* xk = x + k * n;
+      for (size_t i = 0; i < n; ++i) {
+        xk[i] = (double(y) + 0.5) * (1.0 / 4294967296.0);
+        y ^= v[ctz(first + i + 1)];
+      }
+    }
+  }
+
+  /// The points mapped to standard normals by the inverse normal cdf, a pack at a time
+  void normals(uint64_t first, size_t n, double* z) const
+  {
+    points(first, n, z);
+    size_t const W = simd::pack::size, size = n * dim_;
+    size_t i = 0;
+    for (; i + W <= size; i += W)
+      simd::inverse_normal_cdf(simd::pack::load(z + i)).store(z + i);
+    for (; i < size; ++i)
+      z[i] = inverse_normal_cdf(z[i]);
+  }
+
+private:
+  static unsigned ctz(uint64_t x)
+  {
+    unsigned c = 0;
+    while (!(x & 1)) {
+      x >>= 1;
+      ++c;
+    }
+    return c;
+  }
+
+  /// Output digit r (bit 31 - r) is its own digit plus a random subset of the ones before it
+  void scramble_dimension(size_t k, uint64_t seed)
+  {
+    uint32_t L[32];
+    for (unsigned r = 0; r < 32; ++r) {
+      random::philox w(uint32_t(k), r, 1, 0, seed);
+      uint32_t above = r == 0 ? 0 : ~0u << (32 - r);
+      L[r] = (1u << (31 - r)) | (w.c[0] & above);
+    }
+    for (size_t j = 0; j < 32; ++j) {
+      uint32_t v = v_[k * 32 + j], s = 0;
+      for (unsigned r = 0; r < 32; ++r) {
+        uint32_t t = v & L[r];
+        t ^= t >> 16; t ^= t >> 8; t ^= t >> 4; t ^= t >> 2; t ^= t >> 1;
+        s |= (t & 1) << (31 - r);
+      }
+      v_[k * 32 + j] = s;
+    }
+    shift_[k] = random::philox(uint32_t(k), 0, 2, 0, seed).c[0];
+  }
+
+  size_t dim_;
+  std::vector<uint32_t> v_, shift_;
+};
+
+/**
+ * Brownian bridge construction of W at times t_1 < ... < t_n from n standard normals. The
+ * first normal sets W(t_n) and each next one the midpoint of an interval already bounded, so
+ * the leading dimensions of a low discrepancy sequence carry most of the variance of a path.
+ **/
+class brownian_bridge
+{
+public:
+  /// Times 1, 2, ..., n, the increments of W are then standard normals
+  explicit brownian_bridge(size_t n) : brownian_bridge(unit_times(n)) {}
+
+  explicit brownian_bridge(std::vector<double> const& t)
+    : point_(t.size()), left_(t.size()), right_(t.size()), a_(t.size()), b_(t.size()),
+      s_(t.size())
+  {
+    size_t n = t.size();
+    assert(n > 0);
+    auto time = [&](size_t i) { return i == 0 ? 0.0 : t[i - 1]; };  // point i - 1 at index i
+    point_[0] = n;
+    left_[0] = right_[0] = 0;
+    a_[0] = b_[0] = 0;
+    s_[0] = sqrt(t[n - 1]);
+    // breadth first over intervals (l, r) of known points, 0 being the origin
+    std::vector<std::pair<size_t, size_t>> queue(1, std::make_pair(size_t(0), n));
+    size_t j = 1;
+    for (size_t q = 0; q < queue.size(); ++q) {
+      size_t l = queue[q].first, r = queue[q].second;
+      if (r - l < 2)
+        continue;
+      size_t i = l + (r - l) / 2;
+      double tl = time(l), ti = time(i), tr = time(r);
+      point_[j] = i;
+      left_[j] = l;
+      right_[j] = r;
+      a_[j] = (tr - ti) / (tr - tl);
+      b_[j] = (ti - tl) / (tr - tl);
+      s_[j] = sqrt((ti - tl) * (tr - ti) / (tr - tl));
+      ++j;
+      queue.push_back(std::make_pair(l, i));
+      queue.push_back(std::make_pair(i, r));
+    }
+  }
+
+  size_t size() const { return point_.size(); }
+
+  /**
+   * Paths of m samples dimension major, normals z[k * m + i] in and W(t_k+1) in w[k * m + i],
+   * stepped a pack of samples at a time. z and w must not overlap.
+   **/
+  void transform(double const* z, double* w, size_t m) const
+  {
+    size_t const W = simd::pack::size;
+    assert(m % W == 0);
+    for (size_t j = 0; j < size(); ++j) {
+      double* wi = w + (point_[j] - 1) * m;
+      double const* zj = z + j * m;
+      simd::pack s(s_[j]), a(a_[j]), b(b_[j]);
+      if (j == 0) {
+        for (size_t i = 0; i < m; i += W)
+          (s * simd::pack::load(zj + i)).store(wi + i);
+        continue;
+      }
+      double const* wr = w + (right_[j] - 1) * m;
+      double const* wl = left_[j] == 0 ? nullptr : w + (left_[j] - 1) * m;
+      for (size_t i = 0; i < m; i += W) {
+        simd::pack x = b * simd::pack::load(wr + i) + s * simd::pack::load(zj + i);
+        if (wl)
+          x = x + a * simd::pack::load(wl + i);
+        x.store(wi + i);
+      }
+    }
+  }
+
+private:
+  static std::vector<double> unit_times(size_t n)
+  {
+    std::vector<double> t(n);
+    for (size_t i = 0; i < n; ++i)
+      t[i] = double(i + 1);
+    return t;
+  }
+
+  std::vector<size_t> point_, left_, right_;   // 1 based, 0 is the origin
+  std::vector<double> a_, b_, s_;
+};
+
+} } // namespace sfinx::qmc
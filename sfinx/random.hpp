@@ -0,0 +1,225 @@
+#pragma once
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include "math.hpp"
+#include "simd.hpp"
+
+namespace sfinx { namespace random {
+
+/**
+ * Philox4x32-10 counter based generator (Salmon et al. 2011). Every call maps a 128 bit counter
+ * and a 64 bit key to 128 random bits with no state in between, so any draw can be produced
+ * by any thread in any order and a simulation reruns bit for bit.
+ **/
+struct philox
+{
+  uint32_t c[4];
+
+  philox(uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3, uint64_t key)
+  {
+    uint32_t k0 = uint32_t(key), k1 = uint32_t(key >> 32);
+    c[0] = c0; c[1] = c1; c[2] = c2; c[3] = c3;
+    for (int i = 0; i < 10; ++i) {
+      uint64_t p0 = uint64_t(0xD2511F53u) * c[0], p1 = uint64_t(0xCD9E8D57u) * c[2];
+      uint32_t x0 = uint32_t(p1 >> 32) ^ c[1] ^ k0, x2 = uint32_t(p0 >> 32) ^ c[3] ^ k1;
+      c[1] = uint32_t(p1);
+      c[3] = uint32_t(p0);
+      c[0] = x0;
+      c[2] = x2;
+      k0 += 0x9E3779B9u;
+      k1 += 0xBB67AE85u;
+    }
+  }
+};
+
+/// Uniform on the open interval (0, 1) with 53 bits from two words
+inline double uniform(uint32_t hi, uint32_t lo)
+{
+  uint64_t m = (uint64_t(hi) << 21) ^ (lo >> 11);
+  return (double(m) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+namespace aux {
+
+/**
+ * Box-Muller on uniforms u1, u2, Num is double or simd::pack. The angle 2 pi u2 is split into
+ * a quadrant and a remainder in [-pi/4, pi/4], where short Taylor polynomials give sine and
+ * cosine to double precision without a general range reduction.
+ **/
+template <typename Num>
+inline void box_muller(Num u1, Num u2, Num& z0, Num& z1)
+{
+  Num r = sqrt(-2 * log(u1)), q = floor(4 * u2 + 0.5), a = (4 * u2 - q) * (Pi / 2), a2 = a * a;
+  Num s = a * (1 + a2 * (-1.0 / 6 + a2 * (1.0 / 120 + a2 * (-1.0 / 5040 + a2 * (1.0 / 362880
+          + a2 * (-1.0 / 39916800 + a2 * (1.0 / 6227020800 + a2 * (-1.0 / 1307674368000))))))));
+  Num c = 1 + a2 * (-1.0 / 2 + a2 * (1.0 / 24 + a2 * (-1.0 / 720 + a2 * (1.0 / 40320
+          + a2 * (-1.0 / 3628800 + a2 * (1.0 / 479001600 + a2 * (-1.0 / 87178291200)))))));
+  // rotate by q quarter turns
+  auto odd = (q == 1.0) | (q == 3.0);
+  auto neg_c = (q == 1.0) | (q == 2.0), neg_s = (q == 2.0) | (q == 3.0);
+  Num cs = simd::select(odd, s, c), sn = simd::select(odd, c, s);
+  z0 = r * simd::select(neg_c, -cs, cs);
+  z1 = r * simd::select(neg_s, -sn, sn);
+}
+
+} // namespace sfinx::random::aux
+
+/// Two independent standard normals from one philox block
+inline void normals(philox const& w, double& z0, double& z1)
+{
+  aux::box_muller(uniform(w.c[0], w.c[1]), uniform(w.c[2], w.c[3]), z0, z1);
+}
+
+/**
+ * Normals z[0, n) of draws first, first + 1, ... of dimension d in the stream of seed, first and
+ * n are multiples of 16. In each group of 16 draws g, draws g + j and g + 8 + j are the pair
+ * from counter (g / 2 + j, d), so the uniforms are written to z in the order the packs of any
+ * width transform them in place.
+ **/
+inline void normals(uint64_t seed, uint64_t first, uint32_t d, double* z, size_t n)
+{
+  size_t const W = simd::pack::size, G = 8;
+  assert(n % (2 * G) == 0 && first % (2 * G) == 0);
+  for (size_t g = 0; g < n; g += 2 * G) {
+    for (size_t j = 0; j < G; ++j) {
+      uint64_t k = (first + g) / 2 + j;
+      philox w(uint32_t(k), uint32_t(k >> 32), d, 0, seed);
+      z[g + j] = uniform(w.c[0], w.c[1]);
+      z[g + G + j] = uniform(w.c[2], w.c[3]);
+    }
+    for (size_t j = 0; j < G; j += W) {
+      simd::pack z0, z1;
+      aux::box_muller(simd::pack::load(z + g + j), simd::pack::load(z + g + G + j), z0, z1);
+      z0.store(z + g + j);
+      z1.store(z + g + G + j);
+    }
+  }
+}
+
+/**
+ * Draws of one path: block j of step k is philox counter (path, path >> 32, k, j) under the
+ * key seed, so what a path draws depends on nothing but seed, path and step, whichever block
+ * or thread simulates it. Each block gives two uniforms or two normals, and samplers that
+ * reject take as many blocks as they need.
+ **/
+class path_stream
+{
+public:
+  path_stream(uint64_t seed, uint64_t path) : seed_(seed), path_(path) { step(0); }
+
+  void step(uint32_t k)
+  {
+    step_ = k;
+    block_ = 0;
+    uniforms_ = 0;
+    normal_ = false;
+  }
+
+  double uniform()
+  {
+    if (uniforms_ == 0) {
+      philox w = next();
+      u_[0] = random::uniform(w.c[0], w.c[1]);
+      u_[1] = random::uniform(w.c[2], w.c[3]);
+      uniforms_ = 2;
+    }
+    return u_[2 - uniforms_--];
+  }
+
+  double normal()
+  {
+    if (normal_) {
+      normal_ = false;
+      return z_;
+    }
+    double z0;
+    normals(next(), z0, z_);
+    normal_ = true;
+    return z0;
+  }
+
+private:
+  philox next()
+  {
+    return philox(uint32_t(path_), uint32_t(path_ >> 32), step_, block_++, seed_);
+  }
+
+  uint64_t seed_, path_;
+  uint32_t step_, block_;
+  unsigned uniforms_;
+  bool normal_;
+  double u_[2], z_;
+};
+
+/**
+ * Gamma(shape, 1) by Marsaglia and Tsang's squeeze, shape < 1 through
+ * Gamma(shape) = Gamma(shape + 1) U^(1 / shape)
+ **/
+template <typename Stream>
+double gamma(Stream& s, double shape)
+{
+  assert(shape > 0);
+  double boost = 1;
+  if (shape < 1) {
+    boost = std::pow(s.uniform(), 1 / shape);
+    shape += 1;
+  }
+  double d = shape - 1.0 / 3, c = 1 / std::sqrt(9 * d);
+  for (;;) {
+    double x = s.normal(), v = 1 + c * x;
+    if (v <= 0)
+      continue;
+    v = v * v * v;
+    double u = s.uniform();
+    if (u < 1 - 0.0331 * x * x * x * x || std::log(u) < x * x / 2 + d * (1 - v + std::log(v)))
+      return d * v * boost;
+  }
+}
+
+/**
+ * Poisson(mean), multiplication of uniforms for small means and Hormann's transformed
+ * rejection with squeeze (PTRS) from 10 on, both exact
+ **/
+template <typename Stream>
+double poisson(Stream& s, double mean)
+{
+  if (mean < 10) {
+    double limit = std::exp(-mean), p = s.uniform(), k = 0;
+    for (; p > limit; ++k)
+      p *= s.uniform();
+    return k;
+  }
+  double sl = std::sqrt(mean), ll = std::log(mean);
+  double b = 0.931 + 2.53 * sl, a = -0.059 + 0.02483 * b;
+  double inv_alpha = 1.1239 + 1.1328 / (b - 3.4), vr = 0.9277 - 3.6224 / (b - 2);
+  for (;;) {
+    double u = s.uniform() - 0.5, v = s.uniform(), us = 0.5 - std::abs(u);
+    double k = std::floor((2 * a / us + b) * u + mean + 0.43);
+    if (us >= 0.07 && v <= vr)
+      return k;
+    if (k < 0 || (us < 0.013 && v > us))
+      continue;
+    if (std::log(v * inv_alpha / (a / (us * us) + b)) <= -mean + k * ll - std::lgamma(k + 1))
+      return k;
+  }
+}
+
+/**
+ * Noncentral chi-square of d degrees of freedom and noncentrality lambda, for d > 1 as
+ * (Z + sqrt(lambda))^2 plus a central chi-square of d - 1, otherwise as a central chi-square
+ * of d + 2N with N Poisson of mean lambda / 2
+ **/
+template <typename Stream>
+double noncentral_chi_square(Stream& s, double d, double lambda)
+{
+  if (d > 1) {
+    double z = s.normal() + std::sqrt(lambda);
+    return z * z + 2 * gamma(s, (d - 1) / 2);
+  }
+  double n = lambda > 0 ? poisson(s, lambda / 2) : 0;
+  return d + 2 * n > 0 ? 2 * gamma(s, d / 2 + n) : 0;
+}
+
+} } // namespace sfinx::random
@@ -0,0 +1,136 @@
+#pragma once
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include "span.hpp"
+#include "thread_pool.hpp"
+#include "cashflow_book.hpp"
+
+namespace sfinx { namespace scenario {
+
+/**
+ * Key rate bump of the zero rate: bump at tenor, falling linearly to 0 at left and right.
+ * left == tenor keeps the full bump below the tenor, right == tenor above it, as for the
+ * first and the last key rate of a set.
+ **/
+struct key_rate
+{
+  double left, tenor, right, bump;
+
+  double operator()(double t) const
+  {
+    if (t < tenor)
+      return t <= left ? (left == tenor ? bump : 0) : bump * (t - left) / (tenor - left);
+    return t >= right ? (right == tenor ? bump : 0) : bump * (right - t) / (right - tenor);
+  }
+};
+
+/**
+ * Scenario as a change of the continuously compounded zero rate,
+ *   dz(t) = shift + twist (t - pivot) + sum of the key rate bumps,
+ * a few numbers instead of a curve. A scenario curve is the base discounted by exp(-dz(t) t).
+ **/
+struct overlay
+{
+  double shift, twist, pivot;
+  std::vector<key_rate> keys;
+
+  static overlay parallel(double shift) { return overlay{ shift, 0, 0, {} }; }
+  static overlay steepener(double twist, double pivot) { return overlay{ 0, twist, pivot, {} }; }
+  static overlay key(double left, double tenor, double right, double bump)
+  {
+    return overlay{ 0, 0, 0, { key_rate{ left, tenor, right, bump } } };
+  }
+
+  /// Zero rate change at t
+  double operator()(double t) const
+  {
+    double dz = shift + twist * (t - pivot);
+    for (key_rate const& k : keys)
+      dz += k(t);
+    return dz;
+  }
+};
+
+/// Base curve under an overlay, evaluated on the fly; Curve has df(t)
+template <typename Curve>
+class shifted
+{
+public:
+  shifted(Curve const& base, overlay const& o) : base_(&base), o_(&o) {}
+
+  double df(double t) const
+  {
+    double dz = (*o_)(t);
+    return dz == 0 ? base_->df(t) : base_->df(t) * exp(-dz * t);
+  }
+
+  /// At t = 0 the short rate of the base, which then needs zero(0), plus the overlay there
+  double zero(double t) const { return t > 0 ? -log(df(t)) / t : base_->zero(0.0) + (*o_)(0.0); }
+  double operator()(double t) const { return df(t); }
+
+private:
+  Curve const* base_;
+  overlay const* o_;
+};
+
+template <typename Curve>
+shifted<Curve> apply(Curve const& base, overlay const& o)
+{
+  return shifted<Curve>(base, o);
+}
+
+/**
+ * Prices of every instrument of the book under every scenario, price[s * book.size() + k] for
+ * instrument k under scenarios[s], with table built from book once and kept across calls. The
+ * base discount factors are computed once at the distinct cashflow times of the table; a
+ * scenario only scales them by exp(-dz t) where its overlay is not zero and copies them
+ * elsewhere, so key rate scenarios touch a few times. Scenarios run in parallel on the pool in
+ * one contiguous run per worker, each run reusing one scratch buffer of discount factors.
+ **/
+template <typename Curve, typename Alloc>
+void reprice(basic_cashflow_book<Alloc> const& book, discount_table const& table,
+             Curve const& base, span<overlay const> scenarios, span<double> price,
+             thread_pool& pool)
+{
+  size_t const n = book.size(), S = scenarios.size();
+  assert(price.size() == S * n);
+  span<double const> t = table.times();
+  span<double const> amounts = book.amounts();
+  span<uint32_t const> slots = table.slots();
+  span<size_t const> offsets = book.offsets();
+  assert(slots.size() == amounts.size());
+  std::vector<double> df0 = table.discount([&](double ti) { return base.df(ti); });
+  size_t const runs = std::min(pool.size(), S);
+  pool.parallel_for(runs, [&](size_t w) {
+    std::vector<double> df(df0.size());
+    for (size_t s = S * w / runs; s < S * (w + 1) / runs; ++s) {
+      overlay const& o = scenarios[s];
+      std::copy(df0.begin(), df0.end(), df.begin());
+      for (size_t i = 0; i < t.size(); ++i) {
+        double dz = o(t[i]);
+        if (dz != 0)
+          df[i] *= exp(-dz * t[i]);
+      }
+      for (size_t k = 0; k < n; ++k) {
+        double p = 0;
+        for (size_t j = offsets[k]; j < offsets[k + 1]; ++j)
+          p += amounts[j] * df[slots[j]];
+        price[s * n + k] = p;
+      }
+    }
+  });
+}
+
+/// With the table of the book built for this call
+template <typename Curve, typename Alloc>
+void reprice(basic_cashflow_book<Alloc> const& book, Curve const& base,
+             span<overlay const> scenarios, span<double> price, thread_pool& pool)
+{
+  reprice(book, discount_table(book), base, scenarios, price, pool);
+}
+
+} } // namespace sfinx::scenario
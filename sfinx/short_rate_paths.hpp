@@ -0,0 +1,183 @@
+#pragma once
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include "span.hpp"
+#include "random.hpp"
+#include "thread_pool.hpp"
+#include "interest_rate.hpp"
+
+namespace sfinx { namespace interest_rate {
+
+struct path_settings
+{
+  size_t paths = 1 << 16;
+  size_t steps = 12;           // equally spaced dates after 0, dt apart
+  uint64_t seed = 0;
+};
+
+/**
+ * Block of paths handed to the consumer: the short rate of path first + i at the date k dt
+ * in r[k * size + i], k = 0 the initial rate. Only valid during the call.
+ **/
+struct path_block
+{
+  size_t index, first, size, steps;
+  double dt;
+  double const* r;
+
+  span<double const> rates(size_t k) const { return span<double const>(r + k * size, size); }
+};
+
+namespace aux {
+
+/// (1 - exp(-a t)) / a, t where a is 0
+inline double decay(double a, double t)
+{
+  return a == 0 ? t : -std::expm1(-a * t) / a;
+}
+
+} // namespace sfinx::interest_rate::aux
+
+/**
+ * Exact Vasicek transition over dt, Gaussian of mean b + (r - b) exp(-a dt) and variance
+ * sigma^2 (1 - exp(-2a dt)) / 2a
+ **/
+class vasicek_process
+{
+public:
+  vasicek_process(short_rate_params const& p, double dt)
+    : r0_(p.r0), b_(p.b), e_(exp(-p.a * dt)), v_(p.sigma * sqrt(aux::decay(2 * p.a, dt))), dt_(dt)
+  {
+  }
+
+  double r0() const { return r0_; }
+  double dt() const { return dt_; }
+  size_t steps() const { return std::numeric_limits<size_t>::max(); }    // any number
+
+  double operator()(double r, size_t, random::path_stream& s) const
+  {
+    return b_ + (r - b_) * e_ + v_ * s.normal();
+  }
+
+private:
+  double r0_, b_, e_, v_, dt_;
+};
+
+/**
+ * Exact Cox-Ingersoll-Ross transition over dt, c times a noncentral chi-square of
+ * d = 4ab / sigma^2 degrees of freedom and noncentrality r exp(-a dt) / c, with
+ * c = sigma^2 (1 - exp(-a dt)) / 4a. The rate stays non negative whatever the Feller condition.
+ **/
+class cir_process
+{
+public:
+  cir_process(short_rate_params const& p, double dt)
+    : r0_(p.r0), e_(exp(-p.a * dt)), c_(p.sigma * p.sigma * aux::decay(p.a, dt) / 4),
+      d_(4 * p.a * p.b / (p.sigma * p.sigma)), dt_(dt)
+  {
+    assert(p.r0 >= 0 && p.a >= 0 && p.b >= 0 && p.sigma > 0);
+  }
+
+  double r0() const { return r0_; }
+  double dt() const { return dt_; }
+  size_t steps() const { return std::numeric_limits<size_t>::max(); }    // any number
+
+  double operator()(double r, size_t, random::path_stream& s) const
+  {
+    return c_ * random::noncentral_chi_square(s, d_, r * e_ / c_);
+  }
+
+private:
+  double r0_, e_, c_, d_, dt_;
+};
+
+/**
+ * Exact Hull-White transition fitted to the initial curve: r - alpha(t) is an Ornstein-Uhlenbeck
+ * process from 0, alpha(t) = f(0, t) + sigma^2 / 2 ((1 - exp(-a t)) / a)^2. alpha is computed
+ * once at the dates of the paths.
+ **/
+class hull_white_process
+{
+public:
+  template <typename Curve>
+  hull_white_process(Curve const& curve, hull_white_params const& p, double dt, size_t steps)
+    : e_(exp(-p.a * dt)), v_(p.sigma * sqrt(aux::decay(2 * p.a, dt))), dt_(dt), alpha_(steps + 1)
+  {
+    for (size_t k = 0; k <= steps; ++k) {
+      double t = k * dt, B = aux::decay(p.a, t);
+      alpha_[k] = aux::forward(curve, t) + p.sigma * p.sigma * B * B / 2;
+    }
+  }
+
+  double r0() const { return alpha_[0]; }
+  double dt() const { return dt_; }
+  size_t steps() const { return alpha_.size() - 1; }    // alpha is known up to steps dt
+
+  /// From the rate r at date k to date k + 1
+  double operator()(double r, size_t k, random::path_stream& s) const
+  {
+    assert(k + 1 < alpha_.size());
+    return alpha_[k + 1] + (r - alpha_[k]) * e_ + v_ * s.normal();
+  }
+
+private:
+  double e_, v_, dt_;
+  std::vector<double> alpha_;
+};
+
+namespace aux {
+
+/// Paths per block, handed to the consumer together
+size_t const path_block = 256;
+
+} // namespace sfinx::interest_rate::aux
+
+/**
+ * Simulate the short rate of the process on s.paths paths of s.steps exact transitions and
+ * stream them to consumer(path_block const&) a block of at most 256 paths at a time. Blocks
+ * run in parallel on the pool, each in a buffer of its own that is released once the consumer
+ * returns, so memory stays at a block per thread whatever the number of paths. Path p draws
+ * from random::path_stream(s.seed, p) alone: a path is the same for any pool. The consumer is
+ * called concurrently and should accumulate into the slot of b.index, reduced in block order
+ * afterwards for results independent of the pool. Throws std::invalid_argument when the
+ * process is set up for fewer than s.steps steps.
+ **/
+template <typename Process, typename Consumer>
+void simulate(Process const& process, path_settings const& s, Consumer const& consumer,
+              thread_pool& pool)
+{
+  size_t const B = aux::path_block;
+  if (s.steps > process.steps())
+    throw std::invalid_argument("simulate: more steps than the process is set up for");
+  pool.parallel_for((s.paths + B - 1) / B, [&](size_t j) {
+    size_t first = j * B, n = std::min(B, s.paths - first);
+    std::vector<double> r((s.steps + 1) * n);
+    for (size_t i = 0; i < n; ++i) {
+      random::path_stream stream(s.seed, first + i);
+      double x = process.r0();
+      r[i] = x;
+      for (size_t k = 0; k < s.steps; ++k) {
+        stream.step(uint32_t(k));
+        x = process(x, k, stream);
+        r[(k + 1) * n + i] = x;
+      }
+    }
+    consumer(path_block{ j, first, n, s.steps, process.dt(), r.data() });
+  });
+}
+
+/// On the calling thread
+template <typename Process, typename Consumer>
+void simulate(Process const& process, path_settings const& s, Consumer const& consumer)
+{
+  thread_pool inline_pool(1);
+  simulate(process, s, consumer, inline_pool);
+}
+
+} } // namespace sfinx::interest_rate
@@ -0,0 +1,411 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include "math.hpp"
+#include "span.hpp"
+
+/**
+ * Packs of doubles for the batch kernels, the width is chosen at compile time:
+ *   -mavx512f          8 lanes
+ *   -mavx2 -mfma       4 lanes
+ *   otherwise          1 lane, every function forwards to the scalar <cmath> one
+ * Define SFINX_NO_SIMD to force the scalar fallback.
+ *
+ * The vector exp/log are Cephes based and within 2 ulp of libm over the normal range,
+ * erfc is W. J. Cody's rational approximation and within 5 ulp of libm down to its
+ * underflow at x = 26.5.
+ **/
+#if !defined(SFINX_NO_SIMD) && defined(__AVX512F__)
+#  define SFINX_SIMD_AVX512
+#elif !defined(SFINX_NO_SIMD) && defined(__AVX2__) && defined(__FMA__)
+#  define SFINX_SIMD_AVX2
+#endif
+
+#if defined(SFINX_SIMD_AVX512) || defined(SFINX_SIMD_AVX2)
+#  define SFINX_SIMD_VECTOR
+#  include <immintrin.h>
+#endif
+
+namespace sfinx { namespace simd {
+
+#if defined(SFINX_SIMD_AVX512)
+
+struct mask
+{
+  __mmask8 m;
+  mask(__mmask8 m) : m(m) {}
+  friend mask operator&(mask a, mask b) { return __mmask8(a.m & b.m); }
+  friend mask operator|(mask a, mask b) { return __mmask8(a.m | b.m); }
+  friend mask operator~(mask a) { return __mmask8(~a.m); }
+  friend mask operator!(mask a) { return ~a; }
+};
+
+inline unsigned bits(mask a) { return a.m; }
+
+struct pack
+{
+  static constexpr size_t size = 8;
+  __m512d v;
+
+  pack() {}
+  pack(double x) : v(_mm512_set1_pd(x)) {}
+  pack(__m512d v) : v(v) {}
+
+  static pack load(double const* p) { return _mm512_loadu_pd(p); }
+  void store(double* p) const { _mm512_storeu_pd(p, v); }
+
+  friend pack operator+(pack a, pack b) { return _mm512_add_pd(a.v, b.v); }
+  friend pack operator-(pack a, pack b) { return _mm512_sub_pd(a.v, b.v); }
+  friend pack operator*(pack a, pack b) { return _mm512_mul_pd(a.v, b.v); }
+  friend pack operator/(pack a, pack b) { return _mm512_div_pd(a.v, b.v); }
+  friend pack operator-(pack a)
+  {
+    return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a.v),
+                                                _mm512_set1_epi64(INT64_MIN)));
+  }
+
+  friend mask operator<(pack a, pack b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ); }
+  friend mask operator<=(pack a, pack b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_LE_OQ); }
+  friend mask operator>(pack a, pack b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_GT_OQ); }
+  friend mask operator>=(pack a, pack b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_GE_OQ); }
+  friend mask operator==(pack a, pack b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_EQ_OQ); }
+  friend mask operator!=(pack a, pack b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_NEQ_UQ); }
+};
+
+inline pack select(mask m, pack t, pack f) { return _mm512_mask_blend_pd(m.m, f.v, t.v); }
+inline pack min(pack a, pack b) { return _mm512_min_pd(a.v, b.v); }
+inline pack max(pack a, pack b) { return _mm512_max_pd(a.v, b.v); }
+inline pack abs(pack a) { return _mm512_abs_pd(a.v); }
+inline pack sqrt(pack a) { return _mm512_sqrt_pd(a.v); }
+inline pack floor(pack a) { return _mm512_roundscale_pd(a.v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+inline pack trunc(pack a) { return _mm512_roundscale_pd(a.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+inline pack fma(pack a, pack b, pack c) { return _mm512_fmadd_pd(a.v, b.v, c.v); }
+
+namespace aux {
+/// 2^n for integral n
+inline pack pow2n(pack n) { return _mm512_scalef_pd(_mm512_set1_pd(1.0), n.v); }
+
+/// x = m * 2^e, m in [0.5, 1), for finite x > 0
+inline pack frexp(pack x, pack& e)
+{
+  e = _mm512_add_pd(_mm512_getexp_pd(x.v), _mm512_set1_pd(1.0));
+  return _mm512_getmant_pd(x.v, _MM_MANT_NORM_p5_1, _MM_MANT_SIGN_zero);
+}
+} // namespace sfinx::simd::aux
+
+#elif defined(SFINX_SIMD_AVX2)
+
+struct mask
+{
+  __m256d m;
+  mask(__m256d m) : m(m) {}
+  friend mask operator&(mask a, mask b) { return _mm256_and_pd(a.m, b.m); }
+  friend mask operator|(mask a, mask b) { return _mm256_or_pd(a.m, b.m); }
+  friend mask operator~(mask a)
+  {
+    return _mm256_xor_pd(a.m, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)));
+  }
+  friend mask operator!(mask a) { return ~a; }
+};
+
+inline unsigned bits(mask a) { return unsigned(_mm256_movemask_pd(a.m)); }
+
+struct pack
+{
+  static constexpr size_t size = 4;
+  __m256d v;
+
+  pack() {}
+  pack(double x) : v(_mm256_set1_pd(x)) {}
+  pack(__m256d v) : v(v) {}
+
+  static pack load(double const* p) { return _mm256_loadu_pd(p); }
+  void store(double* p) const { _mm256_storeu_pd(p, v); }
+
+  friend pack operator+(pack a, pack b) { return _mm256_add_pd(a.v, b.v); }
+  friend pack operator-(pack a, pack b) { return _mm256_sub_pd(a.v, b.v); }
+  friend pack operator*(pack a, pack b) { return _mm256_mul_pd(a.v, b.v); }
+  friend pack operator/(pack a, pack b) { return _mm256_div_pd(a.v, b.v); }
+  friend pack operator-(pack a) { return _mm256_xor_pd(a.v, _mm256_set1_pd(-0.0)); }
+
+  friend mask operator<(pack a, pack b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ); }
+  friend mask operator<=(pack a, pack b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ); }
+  friend mask operator>(pack a, pack b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ); }
+  friend mask operator>=(pack a, pack b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ); }
+  friend mask operator==(pack a, pack b) { return _mm256_cmp_pd(a.v, b.v, _CMP_EQ_OQ); }
+  friend mask operator!=(pack a, pack b) { return _mm256_cmp_pd(a.v, b.v, _CMP_NEQ_UQ); }
+};
+
+inline pack select(mask m, pack t, pack f) { return _mm256_blendv_pd(f.v, t.v, m.m); }
+inline pack min(pack a, pack b) { return _mm256_min_pd(a.v, b.v); }
+inline pack max(pack a, pack b) { return _mm256_max_pd(a.v, b.v); }
+inline pack abs(pack a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v); }
+inline pack sqrt(pack a) { return _mm256_sqrt_pd(a.v); }
+inline pack floor(pack a) { return _mm256_floor_pd(a.v); }
+inline pack trunc(pack a) { return _mm256_round_pd(a.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+inline pack fma(pack a, pack b, pack c) { return _mm256_fmadd_pd(a.v, b.v, c.v); }
+
+namespace aux {
+/// 2^n for integral n in [-1022, 1023], the biased exponent is built in the mantissa of 2^52 + n + 1023
+inline pack pow2n(pack n)
+{
+  __m256d t = _mm256_add_pd(n.v, _mm256_set1_pd(4503599627370496.0 + 1023));
+  return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_castpd_si256(t), 52));
+}
+
+/// x = m * 2^e, m in [0.5, 1), for finite x > 0 (subnormals are scaled up first)
+inline pack frexp(pack x, pack& e)
+{
+  mask sub = x < pack(std::numeric_limits<double>::min());
+  x = select(sub, x * 18014398509481984.0, x); // 2^54
+  __m256i b = _mm256_castpd_si256(x.v);
+  __m256i eb = _mm256_and_si256(_mm256_srli_epi64(b, 52), _mm256_set1_epi64x(0x7ff));
+  __m256d ed = _mm256_castsi256_pd(_mm256_or_si256(eb, _mm256_set1_epi64x(0x4330000000000000)));
+  e = pack(_mm256_sub_pd(ed, _mm256_set1_pd(4503599627370496.0 + 1022)))
+      - select(sub, pack(54.0), pack(0.0));
+  __m256i m = _mm256_or_si256(_mm256_and_si256(b, _mm256_set1_epi64x(0x000fffffffffffff)),
+                              _mm256_set1_epi64x(0x3fe0000000000000));
+  return _mm256_castsi256_pd(m);
+}
+} // namespace sfinx::simd::aux
+
+#else
+
+struct mask
+{
+  bool m;
+  mask(bool m) : m(m) {}
+  friend mask operator&(mask a, mask b) { return a.m && b.m; }
+  friend mask operator|(mask a, mask b) { return a.m || b.m; }
+  friend mask operator~(mask a) { return !a.m; }
+  friend mask operator!(mask a) { return !a.m; }
+};
+
+inline unsigned bits(mask a) { return a.m ? 1u : 0u; }
+
+struct pack
+{
+  static constexpr size_t size = 1;
+  double v;
+
+  pack() {}
+  pack(double x) : v(x) {}
+
+  static pack load(double const* p) { return *p; }
+  void store(double* p) const { *p = v; }
+
+  friend pack operator+(pack a, pack b) { return a.v + b.v; }
+  friend pack operator-(pack a, pack b) { return a.v - b.v; }
+  friend pack operator*(pack a, pack b) { return a.v * b.v; }
+  friend pack operator/(pack a, pack b) { return a.v / b.v; }
+  friend pack operator-(pack a) { return -a.v; }
+
+  friend mask operator<(pack a, pack b) { return a.v < b.v; }
+  friend mask operator<=(pack a, pack b) { return a.v <= b.v; }
+  friend mask operator>(pack a, pack b) { return a.v > b.v; }
+  friend mask operator>=(pack a, pack b) { return a.v >= b.v; }
+  friend mask operator==(pack a, pack b) { return a.v == b.v; }
+  friend mask operator!=(pack a, pack b) { return a.v != b.v; }
+};
+
+inline pack select(mask m, pack t, pack f) { return m.m ? t : f; }
+inline pack min(pack a, pack b) { return b.v < a.v ? b : a; }
+inline pack max(pack a, pack b) { return a.v < b.v ? b : a; }
+inline pack abs(pack a) { return std::fabs(a.v); }
+inline pack sqrt(pack a) { return std::sqrt(a.v); }
+inline pack floor(pack a) { return std::floor(a.v); }
+inline pack trunc(pack a) { return std::trunc(a.v); }
+inline pack fma(pack a, pack b, pack c) { return std::fma(a.v, b.v, c.v); }
+
+inline pack exp(pack x) { return std::exp(x.v); }
+inline pack log(pack x) { return std::log(x.v); }
+inline pack erfc(pack x) { return std::erfc(x.v); }
+inline pack normal_cdf(pack x) { return sfinx::normal_cdf(x.v); }
+inline pack normal_pdf(pack x) { return sfinx::normal_pdf(x.v); }
+
+#endif
+
+inline bool any(mask m) { return bits(m) != 0; }
+inline bool all(mask m) { return bits(m) == (1u << pack::size) - 1; }
+inline bool none(mask m) { return bits(m) == 0; }
+
+/// Scalar counterparts, so lockstep algorithms can be written once for double and pack
+inline double select(bool m, double t, double f) { return m ? t : f; }
+inline double min(double a, double b) { return b < a ? b : a; }
+inline double max(double a, double b) { return a < b ? b : a; }
+inline double abs(double a) { return std::fabs(a); }
+inline bool any(bool m) { return m; }
+inline bool all(bool m) { return m; }
+inline bool none(bool m) { return !m; }
+
+#if defined(SFINX_SIMD_VECTOR)
+
+inline pack exp(pack x)
+{
+  pack xc = min(max(x, pack(-745.2)), pack(709.8));
+  pack n = floor(fma(xc, 1.4426950408889634074, 0.5));
+  pack r = fma(n, -6.93145751953125e-1, xc);
+  r = fma(n, -1.42860682030941723212e-6, r);
+  pack rr = r * r;
+  pack p = r * fma(fma(1.26177193074810590878e-4, rr, 3.02994407707441961300e-2), rr,
+                   9.99999999999999999910e-1);
+  pack q = fma(fma(fma(3.00198505138664455042e-6, rr, 2.52448340349684104192e-3), rr,
+                   2.27265548208155028766e-1), rr, 2.00000000000000000009e0);
+  pack y = fma(2.0, p / (q - p), 1.0);
+  pack h = floor(n * 0.5);
+  y = y * aux::pow2n(h) * aux::pow2n(n - h);
+  y = select(x > 709.782712893384, std::numeric_limits<double>::infinity(), y);
+  y = select(x < -745.1332191019412, 0.0, y);
+  return select(x != x, x, y);
+}
+
+inline pack log(pack x)
+{
+  pack e, m = aux::frexp(x, e);
+  mask lo = m < 0.70710678118654752440;
+  e = select(lo, e - 1.0, e);
+  m = select(lo, m + m, m) - 1.0;
+  pack z = m * m;
+  pack p = fma(fma(fma(fma(fma(1.01875663804580931796e-4, m, 4.97494994976747001425e-1), m,
+               4.70579119878881725854e0), m, 1.44989225341610930846e1), m,
+               1.79368678507819816313e1), m, 7.70838733755885391666e0);
+  pack q = fma(fma(fma(fma(m + 1.12873587189167450590e1, m, 4.52279145837532221105e1), m,
+               8.29875266912776603211e1), m, 7.11544750618563894466e1), m,
+               2.31251620126765340583e1);
+  pack y = m * (z * p / q);
+  y = fma(e, -2.121944400546905827679e-4, y);
+  y = fma(z, -0.5, y);
+  pack ret = fma(e, 0.693359375, m + y);
+  ret = select(x == std::numeric_limits<double>::infinity(), x, ret);
+  ret = select(x == 0.0, -std::numeric_limits<double>::infinity(), ret);
+  return select(~(x >= 0.0), std::numeric_limits<double>::quiet_NaN(), ret);
+}
+
+/**
+ * Cody's three range rational approximation, all ranges are evaluated and blended
+ **/
+inline pack erfc(pack x)
+{
+  pack y = abs(x);
+
+  // |x| <= 0.46875, 1 - erf(x)
+  pack ysq = y * y;
+  pack num = 1.85777706184603153e-1 * ysq, den = ysq;
+  num = (num + 3.16112374387056560e00) * ysq;  den = (den + 2.36012909523441209e01) * ysq;
+  num = (num + 1.13864154151050156e02) * ysq;  den = (den + 2.44024637934444173e02) * ysq;
+  num = (num + 3.77485237685302021e02) * ysq;  den = (den + 1.28261652607737228e03) * ysq;
+  pack r1 = 1.0 - x * (num + 3.20937758913846947e03) / (den + 2.84423683343917062e03);
+
+  // 0.46875 < |x| <= 4
+  num = 2.15311535474403846e-8 * y; den = y;
+  num = (num + 5.64188496988670089e-1) * y;  den = (den + 1.57449261107098347e01) * y;
+  num = (num + 8.88314979438837594e00) * y;  den = (den + 1.17693950891312499e02) * y;
+  num = (num + 6.61191906371416295e01) * y;  den = (den + 5.37181101862009858e02) * y;
+  num = (num + 2.98635138197400131e02) * y;  den = (den + 1.62138957456669019e03) * y;
+  num = (num + 8.81952221241769090e02) * y;  den = (den + 3.29079923573345963e03) * y;
+  num = (num + 1.71204761263407058e03) * y;  den = (den + 4.36261909014324716e03) * y;
+  num = (num + 2.05107837782607147e03) * y;  den = (den + 3.43936767414372164e03) * y;
+  pack r2 = (num + 1.23033935479799725e03) / (den + 1.23033935480374942e03);
+
+  // |x| > 4
+  pack yb = max(y, 4.0), z = 1.0 / (yb * yb);
+  num = 1.63153871373020978e-2 * z; den = z;
+  num = (num + 3.05326634961232344e-1) * z;  den = (den + 2.56852019228982242e00) * z;
+  num = (num + 3.60344899949804439e-1) * z;  den = (den + 1.87295284992346725e00) * z;
+  num = (num + 1.25781726111229246e-1) * z;  den = (den + 5.27905102951428412e-1) * z;
+  num = (num + 1.60837851487422766e-2) * z;  den = (den + 6.05183413124413191e-2) * z;
+  pack r3 = z * (num + 6.58749161529837803e-4) / (den + 2.33520497626869185e-3);
+  r3 = (5.6418958354775628695e-1 - r3) / yb;
+
+  // exp(-y^2) with the rounding error of y^2 carried separately
+  pack hi = y * y, lo = fma(y, y, -hi);
+  pack r = select(y <= 4.0, r2, r3) * exp(-hi) * (1.0 - lo);
+  r = select(x < 0.0, 2.0 - r, r);
+  return select(y <= 0.46875, r1, r);
+}
+
+inline pack normal_cdf(pack x)
+{
+  return 0.5 * erfc(x * -0.70710678118654752440);
+}
+
+inline pack normal_pdf(pack x)
+{
+  return 0.39894228040143267794 * exp(-0.5 * x * x);
+}
+
+#endif
+
+/**
+ * Lane overloads of the normal::exact, normal::rational and normal::fast tiers. The vector
+ * erfc is Cody's, so the exact and rational tiers coincide on packs.
+ **/
+inline pack exact_cdf(pack x) { return normal_cdf(x); }
+inline pack exact_pdf(pack x) { return normal_pdf(x); }
+
+#if defined(SFINX_SIMD_VECTOR)
+
+inline pack rational_cdf(pack x) { return normal_cdf(x); }
+
+inline pack fast_cdf(pack x)
+{
+  pack y = abs(x), t = 1.0 / fma(0.2316419, y, 1.0);
+  pack q = normal_pdf(y) * t * fma(fma(fma(fma(1.330274429, t, -1.821255978), t, 1.781477937), t,
+                                       -0.356563782), t, 0.319381530);
+  return select(x < 0.0, q, 1.0 - q);
+}
+
+#else
+
+inline pack rational_cdf(pack x) { return normal::rational_cdf(x.v); }
+inline pack fast_cdf(pack x) { return normal::fast_cdf(x.v); }
+
+#endif
+
+#if defined(SFINX_SIMD_VECTOR)
+
+/// Normal quantile, the three branches of AS 241 are evaluated on all lanes and blended
+inline pack inverse_normal_cdf(pack p)
+{
+  pack q = p - 0.5, r = sqrt(-log(min(p, 1.0 - p)));
+  pack t = select(r <= 5.0, sfinx::aux::as241_near(r), sfinx::aux::as241_far(r));
+  t = select(q < 0.0, -t, t);
+  return select(abs(q) <= 0.425, sfinx::aux::as241_central(q), t);
+}
+
+#else
+
+inline pack inverse_normal_cdf(pack p) { return sfinx::inverse_normal_cdf(p.v); }
+
+#endif
+
+/**
+ * Pack starting at element i of s, lanes past the end are filled with fill
+ **/
+inline pack load(span<double const> s, size_t i, double fill = 1.0)
+{
+  if (i + pack::size <= s.size())
+    return pack::load(s.data() + i);
+  double buf[pack::size];
+  for (size_t k = 0; k < pack::size; ++k)
+    buf[k] = i + k < s.size() ? s[i + k] : fill;
+  return pack::load(buf);
+}
+
+/**
+ * Store x at element i of s, lanes past the end are dropped
+ **/
+inline void store(span<double> s, size_t i, pack x)
+{
+  if (i + pack::size <= s.size())
+    return x.store(s.data() + i);
+  double buf[pack::size];
+  x.store(buf);
+  for (size_t k = 0; i + k < s.size(); ++k)
+    s[i + k] = buf[k];
+}
+
+} } // namespace sfinx::simd
+
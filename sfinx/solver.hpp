@@ -1,51 +1,446 @@
 #pragma once
+#include <algorithm>
+#include <cassert>
 #include <cstddef>
+#include <limits>
+#include <tuple>
 #include <utility>
 #include <cmath>
+#include "span.hpp"
+#include "simd.hpp"
 
 namespace sfinx { namespace solver {
 
+/// Work done by a solver and the last bracket around the root, NaN ends while none is known
+struct trace
+{
+  size_t iterations = 0, evaluations = 0;
+  double lo = std::numeric_limits<double>::quiet_NaN();
+  double hi = std::numeric_limits<double>::quiet_NaN();
+};
+
+namespace aux {
+
+/// f counting its evaluations into t
+template <typename F>
+struct counted
+{
+  F f;
+  trace& t;
+
+  template <typename Num>
+  Num operator()(Num x) { ++t.evaluations; return f(x); }
+};
+
+template <typename F>
+counted<F> count(F f, trace& t)
+{
+  return counted<F>{ f, t };
+}
+
+/// Hand the work and the bracket [a, b] in either order to tr, and the result back
+template <typename Num>
+std::pair<Num, Num> finish(trace* tr, trace const& t, Num a, Num b, Num x, Num fx)
+{
+  if (tr) {
+    *tr = t;
+    tr->lo = double(std::min(a, b));
+    tr->hi = double(std::max(a, b));
+  }
+  return std::make_pair(x, fx);
+}
+
+/// Whether [a, b] has shrunk to adjacent doubles around its ends
+template <typename Num>
+bool exhausted(Num a, Num b)
+{
+  Num scale = std::max(std::abs(a), std::abs(b));
+  return std::abs(b - a) <= 4 * std::numeric_limits<Num>::epsilon() * scale;
+}
+
+} // namespace sfinx::solver::aux
+
+/**
+ * Bracketing solvers take a range [a, b] that should hold a sign change of f and return the
+ * pair (x, f(x)) once |f(x)| < eps. Without a sign change they return the end with the smaller
+ * |f|. tr, when given, receives the evaluations and iterations spent and the final bracket.
+ **/
 template <typename F, typename Range, typename Num>
-auto bisection(F f, Range const& r, Num eps, size_t maxIter = 1000)
+auto bisection(F f, Range const& r, Num eps, size_t maxIter = 1000, trace* tr = nullptr)
   -> std::pair<Num, Num>
 {
+  trace t;
+  auto g = aux::count(f, t);
   Num a = std::get<0>(r), b = std::get<1>(r);
-  Num fa = f(a), fb = f(b);
-  if (std::abs(fa) < eps) return std::make_pair(a, fa);
-  if (std::abs(fb) < eps) return std::make_pair(b, fb);
+  Num fa = g(a), fb = g(b);
+  if (std::abs(fa) < eps) return aux::finish(tr, t, a, b, a, fa);
+  if (std::abs(fb) < eps) return aux::finish(tr, t, a, b, b, fb);
   if (fa * fb > 0)
-    return abs(fa) < abs(fb) ? std::make_pair(a, fa) : std::make_pair(b, fb);
-  else if (fb < 0)
+    return std::abs(fa) < std::abs(fb) ? aux::finish(tr, t, a, b, a, fa)
+                                       : aux::finish(tr, t, a, b, b, fb);
+  else if (fb < 0) {
     std::swap(a, b);
+    std::swap(fa, fb);
+  }
 
   while (maxIter--) {
-    Num c = (a + b) / 2, fc = f(c);
-    if (std::abs(fc) < eps) return std::make_pair(c, fc);
-    if (f(a) * fc < 0.0)
+    ++t.iterations;
+    Num c = (a + b) / 2, fc = g(c);
+    if (std::abs(fc) < eps) return aux::finish(tr, t, a, b, c, fc);
+    if (fa * fc < 0.0)
       b = c;
-    else
+    else {
       a = c;
+      fa = fc;
+    }
   }
-  return std::make_pair((a + b) / 2, f((a + b) / 2));
+  Num c = (a + b) / 2;
+  return aux::finish(tr, t, a, b, c, g(c));
 }
 
 template <typename F, typename DF, typename Num>
-auto newton(F f, DF df, Num x0, Num eps, size_t maxIter = 1000)
+auto newton(F f, DF df, Num x0, Num eps, size_t maxIter = 1000, trace* tr = nullptr)
   -> std::pair<Num, Num>
 {
+  trace t;
+  auto g = aux::count(f, t);
   while (maxIter--) {
-    Num fx0 = f(x0);
-    if (std::abs(fx0) < eps)
+    Num fx0 = g(x0);
+    if (std::abs(fx0) < eps) {
+      if (tr) *tr = t;
       return std::make_pair(x0, fx0);
+    }
+    ++t.iterations;
     x0 -= fx0 / df(x0);
   }
   // Fail to converge within maxIter
-  return std::make_pair(x0, f(x0));
+  Num fx0 = g(x0);
+  if (tr) *tr = t;
+  return std::make_pair(x0, fx0);
+}
+
+/**
+ * Secant iteration from the two points of r, no bracket is kept. Fast once close, it can
+ * wander off when started far from the root.
+ **/
+template <typename F, typename Range, typename Num>
+auto secant(F f, Range const& r, Num eps, size_t maxIter = 1000, trace* tr = nullptr)
+  -> std::pair<Num, Num>
+{
+  trace t;
+  auto g = aux::count(f, t);
+  Num x0 = std::get<0>(r), x1 = std::get<1>(r);
+  Num f0 = g(x0), f1 = g(x1);
+  if (std::abs(f0) < std::abs(f1)) {
+    std::swap(x0, x1);
+    std::swap(f0, f1);
+  }
+  while (std::abs(f1) >= eps && maxIter-- && f1 != f0) {
+    ++t.iterations;
+    Num x2 = x1 - f1 * (x1 - x0) / (f1 - f0);
+    x0 = x1;
+    f0 = f1;
+    x1 = x2;
+    f1 = g(x1);
+  }
+  if (tr) *tr = t;
+  return std::make_pair(x1, f1);
+}
+
+/**
+ * Regula falsi with the Illinois modification: the function value kept at an end that
+ * survives twice in a row is halved, so the bracket closes from both sides and convergence is
+ * superlinear instead of one sided.
+ **/
+template <typename F, typename Range, typename Num>
+auto illinois(F f, Range const& r, Num eps, size_t maxIter = 1000, trace* tr = nullptr)
+  -> std::pair<Num, Num>
+{
+  trace t;
+  auto g = aux::count(f, t);
+  Num a = std::get<0>(r), b = std::get<1>(r);
+  Num fa = g(a), fb = g(b);
+  if (std::abs(fa) < eps) return aux::finish(tr, t, a, b, a, fa);
+  if (std::abs(fb) < eps) return aux::finish(tr, t, a, b, b, fb);
+  if (fa * fb > 0)
+    return std::abs(fa) < std::abs(fb) ? aux::finish(tr, t, a, b, a, fa)
+                                       : aux::finish(tr, t, a, b, b, fb);
+  int side = 0;
+  Num c = a, fc = fa;
+  while (maxIter-- && !aux::exhausted(a, b)) {
+    ++t.iterations;
+    c = (a * fb - b * fa) / (fb - fa);
+    fc = g(c);
+    if (std::abs(fc) < eps)
+      break;
+    if (fc * fb > 0) {
+      b = c;
+      fb = fc;
+      if (side == -1)
+        fa /= 2;
+      side = -1;
+    } else {
+      a = c;
+      fa = fc;
+      if (side == 1)
+        fb /= 2;
+      side = 1;
+    }
+  }
+  return aux::finish(tr, t, a, b, c, fc);
+}
+
+/**
+ * Ridders' method: each iteration evaluates the midpoint and the root of the exponential
+ * fit through the ends and the midpoint, which always lies in the bracket. Quadratic order per
+ * two evaluations and never worse than bisection.
+ **/
+template <typename F, typename Range, typename Num>
+auto ridders(F f, Range const& r, Num eps, size_t maxIter = 1000, trace* tr = nullptr)
+  -> std::pair<Num, Num>
+{
+  trace t;
+  auto g = aux::count(f, t);
+  Num a = std::get<0>(r), b = std::get<1>(r);
+  Num fa = g(a), fb = g(b);
+  if (std::abs(fa) < eps) return aux::finish(tr, t, a, b, a, fa);
+  if (std::abs(fb) < eps) return aux::finish(tr, t, a, b, b, fb);
+  if (fa * fb > 0)
+    return std::abs(fa) < std::abs(fb) ? aux::finish(tr, t, a, b, a, fa)
+                                       : aux::finish(tr, t, a, b, b, fb);
+  Num x = a, fx = fa;
+  while (maxIter-- && !aux::exhausted(a, b)) {
+    ++t.iterations;
+    Num m = (a + b) / 2, fm = g(m);
+    if (std::abs(fm) < eps)
+      return aux::finish(tr, t, a, b, m, fm);
+    Num s = std::sqrt(fm * fm - fa * fb);
+    x = m + (m - a) * (fa < fb ? -fm : fm) / s;
+    fx = g(x);
+    if (std::abs(fx) < eps)
+      break;
+    if ((fm < 0) != (fx < 0)) {
+      a = m; fa = fm;
+      b = x; fb = fx;
+    } else if ((fa < 0) != (fx < 0)) {
+      b = x; fb = fx;
+    } else {
+      a = x; fa = fx;
+    }
+  }
+  return aux::finish(tr, t, a, b, x, fx);
+}
+
+/**
+ * Brent's method: inverse quadratic interpolation or secant steps while they make progress,
+ * bisection otherwise. Keeps a bracket, converges superlinearly on smooth functions and in at
+ * most about the square of the bisection count on hostile ones.
+ **/
+template <typename F, typename Range, typename Num>
+auto brent(F f, Range const& r, Num eps, size_t maxIter = 1000, trace* tr = nullptr)
+  -> std::pair<Num, Num>
+{
+  trace t;
+  auto g = aux::count(f, t);
+  Num a = std::get<0>(r), b = std::get<1>(r);
+  Num fa = g(a), fb = g(b);
+  if (std::abs(fa) < eps) return aux::finish(tr, t, a, b, a, fa);
+  if (std::abs(fb) < eps) return aux::finish(tr, t, a, b, b, fb);
+  if (fa * fb > 0)
+    return std::abs(fa) < std::abs(fb) ? aux::finish(tr, t, a, b, a, fa)
+                                       : aux::finish(tr, t, a, b, b, fb);
+  // b is the best estimate, c the other end of the bracket and a the previous b
+  Num c = a, fc = fa, d = b - a, e = d;
+  while (true) {
+    if ((fb > 0) == (fc > 0)) {
+      c = a; fc = fa;
+      d = e = b - a;
+    }
+    if (std::abs(fc) < std::abs(fb)) {
+      a = b; b = c; c = a;
+      fa = fb; fb = fc; fc = fa;
+    }
+    Num tol = 2 * std::numeric_limits<Num>::epsilon() * std::abs(b), m = (c - b) / 2;
+    if (std::abs(fb) < eps || std::abs(m) <= tol || maxIter-- == 0)
+      return aux::finish(tr, t, b, c, b, fb);
+    ++t.iterations;
+    if (std::abs(e) >= tol && std::abs(fa) > std::abs(fb)) {
+      Num s = fb / fa, p, q;
+      if (a == c) {
+        p = 2 * m * s;
+        q = 1 - s;
+      } else {
+        Num qa = fa / fc, rb = fb / fc;
+        p = s * (2 * m * qa * (qa - rb) - (b - a) * (rb - 1));
+        q = (qa - 1) * (rb - 1) * (s - 1);
+      }
+      if (p > 0)
+        q = -q;
+      else
+        p = -p;
+      if (2 * p < std::min(3 * m * q - std::abs(tol * q), std::abs(e * q))) {
+        e = d;
+        d = p / q;
+      } else {
+        d = e = m;
+      }
+    } else {
+      d = e = m;
+    }
+    a = b;
+    fa = fb;
+    b += std::abs(d) > tol ? d : (m > 0 ? tol : -tol);
+    fb = g(b);
+  }
+}
+
+/**
+ * Safeguarded Halley iteration from x, fdf(x) returns the tuple (f, f', f'') of one evaluation.
+ * Steps fall back to Newton where the Halley correction is unreliable. Once two iterates
+ * bracket a sign change a step leaving the bracket bisects it instead, before that a step
+ * leaving the open domain r moves halfway to its bound. Stops when |f| < eps or the next
+ * step is below eps relative to x.
+ **/
+template <typename F, typename Range, typename Num>
+auto halley(F fdf, Num x, Range const& r, Num eps, size_t maxIter = 100, trace* tr = nullptr)
+  -> std::pair<Num, Num>
+{
+  Num lo = std::get<0>(r), hi = std::get<1>(r);
+  Num a = 0, b = 0;   // last iterates with f < 0 and f > 0
+  bool left = false, right = false;
+  trace t;
+  auto done = [&](Num x, Num fx) {
+    if (tr) {
+      *tr = t;
+      if (left && right) {
+        tr->lo = double(std::min(a, b));
+        tr->hi = double(std::max(a, b));
+      }
+    }
+    return std::make_pair(x, fx);
+  };
+
+  while (true) {
+    Num f, df, d2f;
+    std::tie(f, df, d2f) = fdf(x);
+    ++t.evaluations;
+    if (std::abs(f) < eps || t.iterations == maxIter)
+      return done(x, f);
+    ++t.iterations;
+    if (f < 0) { a = x; left = true; }
+    if (f > 0) { b = x; right = true; }
+
+    Num dx = df != 0 ? -f / df : std::numeric_limits<Num>::quiet_NaN();
+    Num c = 1 + dx * d2f / (2 * df);   // Halley divides the Newton step by c
+    if (c > 0.5 && c < 2)
+      dx /= c;
+    Num y = x + dx;
+    if (left && right) {
+      if (!(y > std::min(a, b) && y < std::max(a, b)))
+        y = (a + b) / 2;
+    } else if (!(y > lo)) {
+      y = std::isfinite(double(lo)) ? (x + lo) / 2 : x - 2 * std::abs(x) - 1;
+    } else if (!(y < hi)) {
+      y = std::isfinite(double(hi)) ? (x + hi) / 2 : x + 2 * std::abs(x) + 1;
+    }
+    if (std::abs(y - x) <= eps * (1 + std::abs(x)))
+      return done(x, f);
+    x = y;
+  }
+}
+
+enum class Status : unsigned char
+{
+  Converged,
+  NoBracket,        // f has the same sign at both ends of the range
+  MaxIterations
+};
+
+namespace aux {
+
+/**
+ * Lockstep Ridders on the lanes of a pack, f(x) returns the pack of values at x. Lanes start
+ * on [a, b] and drop out as soon as |f| < eps or the bracket cannot shrink; valid marks the
+ * lanes that hold a problem. Every step stays in the bracket, at least halves it and needs no
+ * per lane history to branch on, so the lanes of a pack finish within a step or two of each
+ * other.
+ **/
+template <typename F>
+void ridders(F f, simd::pack a, simd::pack b, simd::pack eps, size_t maxIter, simd::mask valid,
+             simd::pack& x, simd::pack& iterations, simd::pack& status)
+{
+  typedef simd::pack pack;
+  typedef simd::mask mask;
+  auto sign = [](pack y) { return simd::select(y < 0.0, pack(-1.0), pack(1.0)); };
+  pack fa = f(a), fb = f(b);
+  mask at_a = simd::abs(fa) < eps, at_b = simd::abs(fb) < eps;
+  mask bracket = (sign(fa) != sign(fb)) & (fa == fa) & (fb == fb);
+  mask active = valid & bracket & !(at_a | at_b);
+  x = simd::select(simd::abs(fa) < simd::abs(fb), a, b);
+  pack iter = 0.0, ulp(4 * std::numeric_limits<double>::epsilon());
+  for (size_t k = 0; k < maxIter && simd::any(active); ++k) {
+    pack m = (a + b) / 2, fm = f(m);
+    pack s = sqrt(fm * fm - fa * fb);
+    pack c = simd::select(s > 0.0, m + (m - a) * simd::select(fa < fb, -fm, fm) / s, m);
+    pack fc = f(c);
+
+    mask inner = sign(fm) != sign(fc);
+    mask keep_a = !inner & (sign(fa) != sign(fc));
+    pack a1 = simd::select(inner, m, simd::select(keep_a, a, c));
+    pack fa1 = simd::select(inner, fm, simd::select(keep_a, fa, fc));
+    pack b1 = simd::select(inner | keep_a, c, b), fb1 = simd::select(inner | keep_a, fc, fb);
+    pack scale = simd::max(simd::abs(a1), simd::abs(b1));
+    mask done = (simd::abs(fm) < eps) | (simd::abs(fc) < eps)
+              | (simd::abs(b1 - a1) <= ulp * scale);
+
+    a = simd::select(active, a1, a);
+    fa = simd::select(active, fa1, fa);
+    b = simd::select(active, b1, b);
+    fb = simd::select(active, fb1, fb);
+    x = simd::select(active, simd::select(simd::abs(fm) < simd::abs(fc), m, c), x);
+    iter = simd::select(active, iter + 1.0, iter);
+    active = active & !done;
+  }
+  iterations = iter;
+  status = simd::select(bracket | at_a | at_b,
+                        simd::select(active, pack(double(Status::MaxIterations)),
+                                     pack(double(Status::Converged))),
+                        pack(double(Status::NoBracket)));
 }
 
-/**************** can also add *****************
- * Secant, Broyden, Brent
- ***********************************************/
+} // namespace sfinx::solver::aux
+
+/**
+ * Batch solve of n independent equations of the same shape, problem i on [lo[i], hi[i]].
+ * f(x, i) evaluates problems i, ..., i + simd::pack::size - 1 at the lanes of x, lanes past
+ * the end carry padding and are ignored. A pack of problems advances together and runs until
+ * its last lane converges, so sort or group problems of similar difficulty for the best use
+ * of the lanes. Derivative free and bracketed, see aux::ridders; an iteration costs two
+ * evaluations of f.
+ **/
+template <typename F>
+void solve(F f, span<double const> lo, span<double const> hi, double eps, size_t maxIter,
+           span<double> root, span<unsigned> iterations, span<Status> status)
+{
+  size_t const W = simd::pack::size, n = lo.size();
+  assert(hi.size() == n && root.size() == n && iterations.size() == n && status.size() == n);
+  double it[W], st[W], lane[W];
+  for (size_t k = 0; k < W; ++k)
+    lane[k] = double(k);
+  for (size_t i = 0; i < n; i += W) {
+    simd::mask valid = simd::pack::load(lane) < double(n - i);
+    simd::pack x, its, sts;
+    aux::ridders([&](simd::pack y) { return f(y, i); }, simd::load(lo, i, 0.0),
+                  simd::load(hi, i, 1.0), simd::pack(eps), maxIter, valid, x, its, sts);
+    simd::store(root, i, x);
+    its.store(it);
+    sts.store(st);
+    for (size_t k = 0; k < W && i + k < n; ++k) {
+      iterations[i + k] = unsigned(it[k]);
+      status[i + k] = Status(unsigned(st[k]));
+    }
+  }
+}
 
 } } // namespace sfinx::solver
 
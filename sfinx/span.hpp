@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace sfinx {
+
+/**
+ * Non-owning view over contiguous storage (C array, std::vector, std::array, or pointer + size),
+ * the batch interfaces take their structure-of-arrays arguments this way
+ **/
+template <typename T>
+class span
+{
+public:
+  typedef T element_type;
+  typedef typename std::remove_cv<T>::type value_type;
+  typedef T* iterator;
+
+  span() : data_(nullptr), size_(0) {}
+  span(T* data, size_t size) : data_(data), size_(size) {}
+
+  template <size_t N>
+  span(T (&a)[N]) : data_(a), size_(N) {}
+
+  template <typename C, typename = decltype(std::declval<C&>().data())>
+  span(C& c) : data_(c.data()), size_(c.size()) {}
+
+  T* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  T& operator[](size_t i) const { return data_[i]; }
+
+  iterator begin() const { return data_; }
+  iterator end() const { return data_ + size_; }
+
+  span subspan(size_t offset, size_t count) const { return span(data_ + offset, count); }
+
+private:
+  T* data_;
+  size_t size_;
+};
+
+} // namespace sfinx
+
@@ -0,0 +1,166 @@
+#pragma once
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <vector>
+#include "span.hpp"
+#include "simd.hpp"
+
+namespace sfinx {
+
+enum class Spline
+{
+  Natural,      // C2, zero second derivative at the end knots
+  Monotone      // C1, natural spline slopes limited by the Hyman filter, monotone where the data is
+};
+
+/**
+ * Cubic spline through (x_i, y_i), x increasing, continued linearly with the end slopes
+ * outside the knots. The coefficients are solved once, the natural spline by one tridiagonal
+ * pass, and packed in a table of n + 1 segments in structure of arrays: the left tail, the
+ * n - 1 intervals and the right tail, segment k anchored at x0, x0, ..., x_n-1 and holding
+ * a + h (b + h (c + h d)) in h = x - anchor. Segment k covers the points above k knots, so a
+ * lookup is a count and a Horner step.
+ *
+ * The batch call walks a sorted query array and the knots together, O(n + m), and evaluates
+ * each run of queries within one segment on packs with the coefficients broadcast.
+ **/
+class cubic_spline
+{
+public:
+  cubic_spline(span<double const> x, span<double const> y, Spline kind = Spline::Natural)
+  {
+    size_t n = x.size();
+    assert(n >= 2 && y.size() == n);
+    knots_.assign(x.begin(), x.end());
+    table_.assign(5 * (n + 1), 0.0);
+    double* anchor = &table_[0];
+    double* a = anchor + n + 1;
+    double* b = a + n + 1;
+    double* c = b + n + 1;
+    double* d = c + n + 1;
+
+    std::vector<double> h(n - 1), s(n - 1), m(n);
+    for (size_t i = 0; i + 1 < n; ++i) {
+      h[i] = x[i + 1] - x[i];
+      assert(h[i] > 0);
+      s[i] = (y[i + 1] - y[i]) / h[i];
+    }
+    natural_slopes(h, s, m);
+    if (kind == Spline::Monotone)
+      hyman(s, m);
+
+    anchor[0] = x[0];
+    a[0] = y[0];
+    b[0] = m[0];
+    for (size_t i = 0; i + 1 < n; ++i) {
+      anchor[i + 1] = x[i];
+      a[i + 1] = y[i];
+      b[i + 1] = m[i];
+      c[i + 1] = (3 * s[i] - 2 * m[i] - m[i + 1]) / h[i];
+      d[i + 1] = (m[i] + m[i + 1] - 2 * s[i]) / (h[i] * h[i]);
+    }
+    anchor[n] = x[n - 1];
+    a[n] = y[n - 1];
+    b[n] = m[n - 1];
+  }
+
+  size_t size() const { return knots_.size(); }
+  span<double const> knots() const { return knots_; }
+
+  double operator()(double x) const
+  {
+    return evaluate(std::upper_bound(knots_.begin(), knots_.end(), x) - knots_.begin(), x);
+  }
+
+  /// With the segment of the last query in hint, updated to the segment of x
+  double operator()(double x, size_t& hint) const
+  {
+    size_t n = knots_.size(), k = std::min(hint, n);
+    while (k < n && knots_[k] <= x)
+      ++k;
+    while (k > 0 && knots_[k - 1] > x)
+      --k;
+    hint = k;
+    return evaluate(k, x);
+  }
+
+  /// out[i] = spline(x[i]) for x sorted increasing
+  void operator()(span<double const> x, span<double> out) const
+  {
+    assert(x.size() == out.size() && std::is_sorted(x.begin(), x.end()));
+    size_t const W = simd::pack::size, n = knots_.size();
+    size_t k = 0;
+    for (size_t i = 0, j; i < x.size(); i = j) {
+      // the merge walk finds the run [i, j) of queries in segment k
+      while (k < n && knots_[k] <= x[i])
+        ++k;
+      j = i + 1;
+      while (j < x.size() && (k == n || x[j] < knots_[k]))
+        ++j;
+      simd::pack anchor(table_[k]), a(coefficient(0, k)), b(coefficient(1, k));
+      simd::pack c(coefficient(2, k)), d(coefficient(3, k));
+      size_t l = i;
+      for (; l + W <= j; l += W) {
+        simd::pack h = simd::pack::load(x.data() + l) - anchor;
+        (a + h * (b + h * (c + h * d))).store(out.data() + l);
+      }
+      for (; l < j; ++l)
+        out[l] = evaluate(k, x[l]);
+    }
+  }
+
+private:
+  /// Coefficient j of a, b, c, d of segment k
+  double coefficient(size_t j, size_t k) const { return table_[(j + 1) * (knots_.size() + 1) + k]; }
+
+  double evaluate(size_t k, double x) const
+  {
+    double h = x - table_[k];
+    return coefficient(0, k) + h * (coefficient(1, k) + h * (coefficient(2, k) + h * coefficient(3, k)));
+  }
+
+  /**
+   * Knot slopes of the natural spline. The second derivatives M solve the tridiagonal system
+   * h_i-1 M_i-1 + 2 (h_i-1 + h_i) M_i + h_i M_i+1 = 6 (s_i - s_i-1) with M_0 = M_n-1 = 0,
+   * forward elimination and back substitution in one pass each.
+   **/
+  static void natural_slopes(std::vector<double> const& h, std::vector<double> const& s,
+                             std::vector<double>& m)
+  {
+    size_t n = m.size();
+    std::vector<double> M(n, 0.0), diag(n, 1.0), rhs(n, 0.0);
+    for (size_t i = 1; i + 1 < n; ++i) {
+      double w = i > 1 ? h[i - 1] / diag[i - 1] : 0;
+      diag[i] = 2 * (h[i - 1] + h[i]) - w * h[i - 1];
+      rhs[i] = 6 * (s[i] - s[i - 1]) - w * rhs[i - 1];
+    }
+    for (size_t i = n - 1; i-- > 1;)
+      M[i] = (rhs[i] - h[i] * M[i + 1]) / diag[i];
+    for (size_t i = 0; i + 1 < n; ++i)
+      m[i] = s[i] - h[i] * (2 * M[i] + M[i + 1]) / 6;
+    m[n - 1] = s[n - 2] + h[n - 2] * (M[n - 2] + 2 * M[n - 1]) / 6;
+  }
+
+  /// Hyman filter: slopes of the sign of the data, at most three times the adjacent secants
+  static void hyman(std::vector<double> const& s, std::vector<double>& m)
+  {
+    size_t n = m.size();
+    for (size_t i = 0; i < n; ++i) {
+      double left = i > 0 ? s[i - 1] : s[i], right = i + 1 < n ? s[i] : s[i - 1];
+      if (left * right <= 0) {
+        m[i] = 0;
+        continue;
+      }
+      double sign = right > 0 ? 1 : -1;
+      m[i] = sign * std::min(std::max(0.0, sign * m[i]),
+                             3 * std::min(std::abs(left), std::abs(right)));
+    }
+  }
+
+  std::vector<double> knots_;
+  std::vector<double> table_;    // anchor, a, b, c, d, n + 1 entries each
+};
+
+} // namespace sfinx
@@ -1,5 +1,10 @@
 #pragma once
+#include <cassert>
 #include <cmath>
+#include <cstddef>
+#include "span.hpp"
+#include "simd.hpp"
+#include "thread_pool.hpp"
 
 namespace sfinx {
 namespace term_structure {
@@ -9,13 +14,15 @@ namespace term_structure {
  *                         /1 - exp(-t/lambda)\
  * r(t) = b0 + (b1 + b2) *(--------------------) + b2 * exp(-t/lambda)
  *                         \     t/lambda     /
+ *
+ * At t = 0 the limit b0 + b1 + 2 b2, the short rate.
  **/
 template <typename Decimal>
 Decimal nelson_siegel(Decimal t, Decimal b0, Decimal b1, Decimal b2, Decimal lambda)
 {
-  if (t == 0) return b0;
-  Decimal t1 = t / lambda;
-  return b0 + (b1 + b2) * ((1 - exp(-t1)) / t1) + b2 * exp(-t1);
+  if (t == 0) return b0 + b1 + 2 * b2;
+  Decimal t1 = t / lambda, e = exp(-t1);
+  return b0 + (b1 + b2) * ((1 - e) / t1) + b2 * e;
 }
 
 /**
@@ -23,17 +30,145 @@ Decimal nelson_siegel(Decimal t, Decimal b0, Decimal b1, Decimal b2, Decimal lam
  *                /1 - exp(-t/t1)\       /1 - exp(-t/t1)            \        /1 - exp(-t/t2)            \
  * r(t) = b0 + b*(----------------)+ b2*(--------------- - exp(-t/t1)) + b3*(--------------- - exp(-t/t2))
  *                \     t/t1     /       \     t/t1                 /        \     t/t2                 /
+ *
+ * At t = 0 the limit b0 + b1, the short rate.
  **/
 template <typename Decimal>
 Decimal svensson(Decimal t, Decimal b0, Decimal b1, Decimal b2, Decimal b3, Decimal t1, Decimal t2)
 {
-  if (t == 0) return b0;
-  Decimal x1 = t / t1, x2 = t / t2;
-  return b0 + b1 * (1 - exp(-x1)) / x1 
-            + b2 * (((1 - exp(-x1)) / x1) - exp(-x1))
-            + b3 * (((1 - exp(-x2)) / x2) - exp(-x2));
+  if (t == 0) return b0 + b1;
+  Decimal x1 = t / t1, x2 = t / t2, e1 = exp(-x1), e2 = exp(-x2), l1 = (1 - e1) / x1;
+  return b0 + b1 * l1
+            + b2 * (l1 - e1)
+            + b3 * (((1 - e2) / x2) - e2);
+}
+
+struct nelson_siegel_params
+{
+  double b0, b1, b2, lambda;
+};
+
+struct svensson_params
+{
+  double b0, b1, b2, b3, t1, t2;
+};
+
+/// Curve of the parameters, zero(t) the model rate, continuously compounded
+struct nelson_siegel_curve
+{
+  nelson_siegel_params p;
+
+  double zero(double t) const { return nelson_siegel(t, p.b0, p.b1, p.b2, p.lambda); }
+  double df(double t) const { return exp(-zero(t) * t); }
+};
+
+struct svensson_curve
+{
+  svensson_params p;
+
+  double zero(double t) const { return svensson(t, p.b0, p.b1, p.b2, p.b3, p.t1, p.t2); }
+  double df(double t) const { return exp(-zero(t) * t); }
+};
+
+/// Continuously compounded zero rate, discount factor and instantaneous forward rate
+template <typename Num>
+struct curve_values
+{
+  Num zero, df, forward;
+};
+
+namespace aux {
+
+/// (1 - exp(-x)) / x from e = exp(-x), the limit 1 selected where x is 0
+inline simd::pack slope(simd::pack x, simd::pack e)
+{
+  return simd::select(x == simd::pack(0.0), simd::pack(1.0), (1 - e) / x);
+}
+
+/**
+ * Row k of the output columns, rate(t, zero, forward) evaluating a pack of maturities.
+ * Columns left empty are not written, the discount factor costs one more exp when asked for.
+ **/
+template <typename Rate>
+void tabulate(span<double const> t, size_t k, curve_values<span<double>> const& out,
+              Rate const& rate)
+{
+  size_t const m = t.size();
+  span<double> zero = out.zero.empty() ? out.zero : out.zero.subspan(k * m, m);
+  span<double> df = out.df.empty() ? out.df : out.df.subspan(k * m, m);
+  span<double> forward = out.forward.empty() ? out.forward : out.forward.subspan(k * m, m);
+  for (size_t i = 0; i < m; i += simd::pack::size) {
+    simd::pack ti = simd::load(t, i, 0.0), z, f;
+    rate(ti, z, f);
+    if (!zero.empty()) simd::store(zero, i, z);
+    if (!df.empty()) simd::store(df, i, simd::exp(-z * ti));
+    if (!forward.empty()) simd::store(forward, i, f);
+  }
+}
+
+inline void check(span<double const> t, size_t sets, curve_values<span<double>> const& out)
+{
+  size_t n = t.size() * sets;
+  (void)n;
+  assert(out.zero.empty() || out.zero.size() == n);
+  assert(out.df.empty() || out.df.size() == n);
+  assert(out.forward.empty() || out.forward.size() == n);
+}
+
+} // namespace sfinx::term_structure::aux
+
+/**
+ * nelson_siegel of every parameter set at every maturity, row k of the columns of out for
+ * p[k]. One exp per point serves the zero rate and the forward
+ *   f(t) = b0 + b1 exp(-t/lambda) + b2 (2 - t/lambda) exp(-t/lambda),
+ * maturities go through in packs and parameter sets are spread over the pool.
+ **/
+inline void nelson_siegel(span<double const> t, span<nelson_siegel_params const> p,
+                          curve_values<span<double>> const& out, thread_pool& pool)
+{
+  aux::check(t, p.size(), out);
+  pool.parallel_for(p.size(), [&](size_t k) {
+    nelson_siegel_params const q = p[k];
+    simd::pack b0(q.b0), b1(q.b1), b2(q.b2), b12(q.b1 + q.b2), inv(1 / q.lambda);
+    aux::tabulate(t, k, out, [&](simd::pack ti, simd::pack& z, simd::pack& f) {
+      simd::pack x = ti * inv, e = simd::exp(-x);
+      z = b0 + b12 * aux::slope(x, e) + b2 * e;
+      f = b0 + (b1 + b2 * (2 - x)) * e;
+    });
+  });
+}
+
+/// svensson of every parameter set at every maturity, two exp per point
+inline void svensson(span<double const> t, span<svensson_params const> p,
+                     curve_values<span<double>> const& out, thread_pool& pool)
+{
+  aux::check(t, p.size(), out);
+  pool.parallel_for(p.size(), [&](size_t k) {
+    svensson_params const q = p[k];
+    simd::pack b0(q.b0), b1(q.b1), b2(q.b2), b3(q.b3), inv1(1 / q.t1), inv2(1 / q.t2);
+    aux::tabulate(t, k, out, [&](simd::pack ti, simd::pack& z, simd::pack& f) {
+      simd::pack x1 = ti * inv1, x2 = ti * inv2, e1 = simd::exp(-x1), e2 = simd::exp(-x2);
+      simd::pack l1 = aux::slope(x1, e1);
+      z = b0 + b1 * l1 + b2 * (l1 - e1) + b3 * (aux::slope(x2, e2) - e2);
+      f = b0 + (b1 + b2 * x1) * e1 + b3 * x2 * e2;
+    });
+  });
+}
+
+/// On the calling thread
+inline void nelson_siegel(span<double const> t, span<nelson_siegel_params const> p,
+                          curve_values<span<double>> const& out)
+{
+  thread_pool inline_pool(1);
+  nelson_siegel(t, p, out, inline_pool);
+}
+
+inline void svensson(span<double const> t, span<svensson_params const> p,
+                     curve_values<span<double>> const& out)
+{
+  thread_pool inline_pool(1);
+  svensson(t, p, out, inline_pool);
 }
 
 } // namespace term_structure
 } // namespace sfinx
-
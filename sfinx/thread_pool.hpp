@@ -0,0 +1,161 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sfinx {
+
+/**
+ * Fixed set of worker threads running parallel loops with work stealing. The index range of a
+ * loop is split evenly over the workers, each takes indices from the front of its own range and
+ * when that is empty steals the back half of another. The calling thread takes part as worker
+ * 0, so a pool of size 1 has no threads and runs loops inline.
+ *
+ * Tasks that need reproducible results should write to their own slot of an output array and
+ * leave the reduction to the caller, the order in which indices run is not fixed.
+ **/
+class thread_pool
+{
+public:
+  explicit thread_pool(size_t threads = std::thread::hardware_concurrency())
+    : ranges_(new range[threads > 0 ? threads : 1]), size_(threads > 0 ? threads : 1),
+      generation_(0), busy_(0), stop_(false)
+  {
+    for (size_t w = 1; w < size_; ++w)
+      workers_.emplace_back([this, w] { loop(w); });
+  }
+
+  ~thread_pool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_);
+      stop_ = true;
+    }
+    start_.notify_all();
+    for (auto& t : workers_)
+      t.join();
+  }
+
+  thread_pool(thread_pool const&) = delete;
+  thread_pool& operator=(thread_pool const&) = delete;
+
+  size_t size() const { return size_; }
+
+  /// f(i) for i in [0, n), returns when all are done and rethrows the first exception
+  template <typename F>
+  void parallel_for(size_t n, F const& f)
+  {
+    std::lock_guard<std::mutex> serial(call_);
+    task_ = std::cref(f);
+    error_ = nullptr;
+    for (size_t w = 0; w < size_; ++w) {
+      ranges_[w].begin = n * w / size_;
+      ranges_[w].end = n * (w + 1) / size_;
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_);
+      busy_ = size_ - 1;
+      ++generation_;
+    }
+    start_.notify_all();
+    work(0);
+    {
+      std::unique_lock<std::mutex> lock(m_);
+      done_.wait(lock, [this] { return busy_ == 0; });
+    }
+    if (error_)
+      std::rethrow_exception(error_);
+  }
+
+private:
+  struct range
+  {
+    std::mutex m;
+    size_t begin = 0, end = 0;
+  };
+
+  void loop(size_t w)
+  {
+    size_t seen = 0;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(m_);
+        start_.wait(lock, [&] { return stop_ || generation_ != seen; });
+        if (stop_)
+          return;
+        seen = generation_;
+      }
+      work(w);
+      std::lock_guard<std::mutex> lock(m_);
+      if (--busy_ == 0)
+        done_.notify_one();
+    }
+  }
+
+  void work(size_t w)
+  {
+    size_t i;
+    while (next(w, i)) {
+      try {
+        task_(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(m_);
+        if (!error_)
+          error_ = std::current_exception();
+      }
+    }
+  }
+
+  bool next(size_t w, size_t& i)
+  {
+    {
+      range& own = ranges_[w];
+      std::lock_guard<std::mutex> lock(own.m);
+      if (own.begin < own.end) {
+        i = own.begin++;
+        return true;
+      }
+    }
+    for (size_t k = 1; k < size_; ++k) {
+      range& victim = ranges_[(w + k) % size_];
+      size_t b, e;
+      {
+        std::lock_guard<std::mutex> lock(victim.m);
+        if (victim.begin >= victim.end)
+          continue;
+        e = victim.end;
+        b = victim.begin + (e - victim.begin) / 2;
+        victim.end = b;
+        if (b == victim.begin) {  // a single index left
+          i = b;
+          return true;
+        }
+      }
+      range& own = ranges_[w];
+      std::lock_guard<std::mutex> lock(own.m);
+      own.begin = b + 1;
+      own.end = e;
+      i = b;
+      return true;
+    }
+    return false;
+  }
+
+  std::unique_ptr<range[]> ranges_;
+  size_t size_;
+  std::vector<std::thread> workers_;
+  std::function<void(size_t)> task_;
+  std::exception_ptr error_;
+  std::mutex call_, m_;
+  std::condition_variable start_, done_;
+  size_t generation_, busy_;
+  bool stop_;
+};
+
+} // namespace sfinx